@@ -36,6 +36,9 @@ public class AnchorTeleportation : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"Json",
+				"NetCore",
+				"ReplicationGraph",
 				"Slate",
 				"SlateCore",
 				// ... add private dependencies that you statically link with here ...	
@@ -1,7 +1,14 @@
 #include "Anchor.h"
-#include "TeleportationSubsystem.h"
-#include "GameFramework/Character.h"
-#include "Kismet/GameplayStatics.h"
+#include "TeleportAnchorValidator.h"
+#include "TeleportHandoff.h"
+#include "TeleportationWorldSubsystem.h"
+
+#if WITH_EDITOR
+#include "Misc/DataValidation.h"
+#include "WorldPartition/WorldPartitionActorDesc.h"
+#endif
+
+#define LOCTEXT_NAMESPACE "Anchor"
 
 AAnchor::AAnchor()
 {
@@ -11,7 +18,20 @@ AAnchor::AAnchor()
 void AAnchor::BeginPlay()
 {
 	Super::BeginPlay();
-	GetWorld()->GetTimerManager().SetTimerForNextTick(this, &AAnchor::RegisterWithSubsystem);
+	RegisterWithSubsystem();
+}
+
+void AAnchor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (HasAuthority())
+	{
+		if (UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>())
+		{
+			WorldSubsystem->UnregisterAnchor(this);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AAnchor::RegisterWithSubsystem()
@@ -24,44 +44,116 @@ void AAnchor::RegisterWithSubsystem()
 		UE_LOG(LogTemp, Error, TEXT("GetWorld() returned nullptr"));
 		return;
 	}
-	
-	AActor* SubsystemOwner = UGameplayStatics::GetActorOfClass(World, ACharacter::StaticClass());
-	if (!SubsystemOwner)
+
+	UTeleportationWorldSubsystem* WorldSubsystem = World->GetSubsystem<UTeleportationWorldSubsystem>();
+	if (!WorldSubsystem)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("No valid subsystem owner found"));
-		World->GetTimerManager().SetTimerForNextTick(this, &AAnchor::RegisterWithSubsystem);
+		UE_LOG(LogTemp, Warning, TEXT("TeleportationWorldSubsystem is nullptr"));
 		return;
 	}
+	
+	WorldSubsystem->RegisterAnchor(this);
+
+	UE_LOG(LogTemp, Log, TEXT("Anchor Registered: %s at Location: %s"),
+	       *AnchorID.ToString(), *GetActorLocation().ToString());
+}
 
-	UTeleportationSubsystem* TeleportSubsystem = SubsystemOwner->FindComponentByClass<UTeleportationSubsystem>();
-	if (!TeleportSubsystem)
+FString AAnchor::GetTravelURL() const
+{
+	return FString::Printf(TEXT("%s?%s=%s"), *DestinationAddress, FTeleportHandoff::AnchorOption, *DestinationAnchorID.ToString());
+}
+
+#if WITH_EDITOR
+FTeleportAnchorValidator* AAnchor::GetEditorValidator() const
+{
+	// Only editor worlds, PIE copies would count every anchor twice
+	const UWorld* World = GetWorld();
+	if (!World || World->IsGameWorld() || IsTemplate()) return nullptr;
+
+	UTeleportationWorldSubsystem* WorldSubsystem = World->GetSubsystem<UTeleportationWorldSubsystem>();
+	return WorldSubsystem ? &WorldSubsystem->GetAnchorValidator() : nullptr;
+}
+
+void AAnchor::PostRegisterAllComponents()
+{
+	Super::PostRegisterAllComponents();
+
+	if (FTeleportAnchorValidator* Validator = GetEditorValidator())
 	{
-		UE_LOG(LogTemp, Warning, TEXT("TeleportationSubsystem is nullptr"));
-		World->GetTimerManager().SetTimerForNextTick(this, &AAnchor::RegisterWithSubsystem);
-		return;
+		Validator->Update(this);
 	}
-	
-	FReplicatedAnchorList* AnchorEntry = TeleportSubsystem->AnchorPairs.FindByPredicate(
-		[this](const FReplicatedAnchorList& Entry)
-		{
-			return Entry.AnchorID == AnchorID;
-		});
+}
 
-	if (AnchorEntry)
+void AAnchor::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (FTeleportAnchorValidator* Validator = GetEditorValidator())
 	{
-		if (!AnchorEntry->Anchors.Contains(this))
-		{
-			AnchorEntry->Anchors.Add(this);
-		}
+		Validator->Update(this);
 	}
-	else
+}
+
+void AAnchor::Destroyed()
+{
+	if (FTeleportAnchorValidator* Validator = GetEditorValidator())
 	{
-		FReplicatedAnchorList NewEntry;
-		NewEntry.AnchorID = AnchorID;
-		NewEntry.Anchors.Add(this);
-		TeleportSubsystem->AnchorPairs.Add(NewEntry);
+		Validator->Remove(this);
 	}
 
-	UE_LOG(LogTemp, Log, TEXT("Anchor Registered: %s at Location: %s"),
-	       *AnchorID.ToString(), *GetActorLocation().ToString());
+	Super::Destroyed();
 }
+
+void AAnchor::GetActorDescProperties(FPropertyPairsMap& PropertyPairsMap) const
+{
+	Super::GetActorDescProperties(PropertyPairsMap);
+
+	PropertyPairsMap.AddProperty(FTeleportAnchorValidator::AnchorIDProperty, AnchorID);
+	if (IsRemote())
+	{
+		PropertyPairsMap.AddProperty(FTeleportAnchorValidator::RemoteProperty);
+	}
+}
+
+EDataValidationResult AAnchor::IsDataValid(FDataValidationContext& Context) const
+{
+	EDataValidationResult Result = Super::IsDataValid(Context);
+
+	if (AnchorID.IsNone())
+	{
+		Context.AddError(LOCTEXT("MissingAnchorID", "Anchor has no AnchorID and cannot be paired"));
+		Result = EDataValidationResult::Invalid;
+	}
+
+	if (IsRemote() && DestinationAnchorID.IsNone())
+	{
+		Context.AddError(LOCTEXT("MissingDestinationAnchorID", "Remote anchor has no DestinationAnchorID to arrive at"));
+		Result = EDataValidationResult::Invalid;
+	}
+
+	if (IsRemote() && DestinationAddress.IsEmpty())
+	{
+		Context.AddError(LOCTEXT("MissingDestinationAddress", "Remote anchor has a DestinationMap but no DestinationAddress, players would leave the server"));
+		Result = EDataValidationResult::Invalid;
+	}
+
+	if (FTeleportAnchorValidator* Validator = GetEditorValidator())
+	{
+		if (!Validator->IsBuilt())
+		{
+			Validator->Rebuild(GetWorld());
+		}
+
+		TArray<FText> Issues;
+		Validator->GetGroupIssues(this, Issues);
+		for (const FText& Issue : Issues)
+		{
+			Context.AddWarning(Issue);
+		}
+	}
+
+	return Result;
+}
+#endif
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AnchorLocationCache.h"
+#include "Anchor.h"
+
+namespace AnchorLocationCache
+{
+	// Padding lanes sit far away so they never win a query, squared distance still fits in a float
+	constexpr float PaddingCoordinate = 1.0e15f;
+	constexpr int32 BatchBlockSize = 1024;
+}
+
+void FAnchorLocationCache::Reset()
+{
+	X.Reset();
+	Y.Reset();
+	Z.Reset();
+	GroupIndex.Reset();
+	Anchors.Reset();
+}
+
+void FAnchorLocationCache::Add(AAnchor* Anchor, int32 InGroupIndex)
+{
+	Add(Anchor, Anchor->GetActorLocation(), InGroupIndex);
+}
+
+void FAnchorLocationCache::Add(AAnchor* Anchor, const FVector& Location, int32 InGroupIndex)
+{
+	// Drop the padding of a previous Finalize before appending
+	X.SetNum(Anchors.Num(), EAllowShrinking::No);
+	Y.SetNum(Anchors.Num(), EAllowShrinking::No);
+	Z.SetNum(Anchors.Num(), EAllowShrinking::No);
+
+	X.Add(static_cast<float>(Location.X));
+	Y.Add(static_cast<float>(Location.Y));
+	Z.Add(static_cast<float>(Location.Z));
+	GroupIndex.Add(InGroupIndex);
+	Anchors.Add(Anchor);
+}
+
+void FAnchorLocationCache::Finalize()
+{
+	const int32 PaddedNum = Align(Anchors.Num(), 4);
+	X.Reserve(PaddedNum);
+	Y.Reserve(PaddedNum);
+	Z.Reserve(PaddedNum);
+	while (X.Num() < PaddedNum)
+	{
+		X.Add(AnchorLocationCache::PaddingCoordinate);
+		Y.Add(AnchorLocationCache::PaddingCoordinate);
+		Z.Add(AnchorLocationCache::PaddingCoordinate);
+	}
+}
+
+static FORCEINLINE VectorRegister4Float DistSquared4(const float* X, const float* Y, const float* Z,
+	const VectorRegister4Float& Px, const VectorRegister4Float& Py, const VectorRegister4Float& Pz)
+{
+	const VectorRegister4Float Dx = VectorSubtract(VectorLoad(X), Px);
+	const VectorRegister4Float Dy = VectorSubtract(VectorLoad(Y), Py);
+	const VectorRegister4Float Dz = VectorSubtract(VectorLoad(Z), Pz);
+	return VectorMultiplyAdd(Dz, Dz, VectorMultiplyAdd(Dy, Dy, VectorMultiply(Dx, Dx)));
+}
+
+// Lanes at or past Num are padding, which can still win when every real anchor is further away than it
+static int32 ReduceNearest(const VectorRegister4Float& Best, const VectorRegister4Float& BestIndex, int32 Num, float& OutDistSquared)
+{
+	alignas(16) float BestLanes[4];
+	alignas(16) float IndexLanes[4];
+	VectorStoreAligned(Best, BestLanes);
+	VectorStoreAligned(BestIndex, IndexLanes);
+
+	int32 Result = INDEX_NONE;
+	OutDistSquared = MAX_flt;
+	for (int32 Lane = 0; Lane < 4; Lane++)
+	{
+		if (IndexLanes[Lane] >= 0.f && IndexLanes[Lane] < Num && BestLanes[Lane] < OutDistSquared)
+		{
+			OutDistSquared = BestLanes[Lane];
+			Result = static_cast<int32>(IndexLanes[Lane]);
+		}
+	}
+	return Result;
+}
+
+int32 FAnchorLocationCache::FindNearest(const FVector& Point, float& OutDistSquared) const
+{
+	OutDistSquared = MAX_flt;
+	if (Anchors.Num() == 0) return INDEX_NONE;
+
+	const VectorRegister4Float Px = VectorSetFloat1(static_cast<float>(Point.X));
+	const VectorRegister4Float Py = VectorSetFloat1(static_cast<float>(Point.Y));
+	const VectorRegister4Float Pz = VectorSetFloat1(static_cast<float>(Point.Z));
+	const VectorRegister4Float Step = VectorSetFloat1(4.f);
+
+	VectorRegister4Float Best = VectorSetFloat1(MAX_flt);
+	VectorRegister4Float BestIndex = VectorSetFloat1(-1.f);
+	VectorRegister4Float LaneIndex = MakeVectorRegisterFloat(0.f, 1.f, 2.f, 3.f);
+
+	const int32 PaddedNum = X.Num();
+	for (int32 i = 0; i < PaddedNum; i += 4)
+	{
+		const VectorRegister4Float DistSq = DistSquared4(&X[i], &Y[i], &Z[i], Px, Py, Pz);
+		const VectorRegister4Float Closer = VectorCompareLT(DistSq, Best);
+		Best = VectorSelect(Closer, DistSq, Best);
+		BestIndex = VectorSelect(Closer, LaneIndex, BestIndex);
+		LaneIndex = VectorAdd(LaneIndex, Step);
+	}
+
+	return ReduceNearest(Best, BestIndex, Anchors.Num(), OutDistSquared);
+}
+
+void FAnchorLocationCache::FindWithinRadius(const FVector& Point, float Radius, TArray<int32>& OutIndices) const
+{
+	OutIndices.Reset();
+
+	const VectorRegister4Float Px = VectorSetFloat1(static_cast<float>(Point.X));
+	const VectorRegister4Float Py = VectorSetFloat1(static_cast<float>(Point.Y));
+	const VectorRegister4Float Pz = VectorSetFloat1(static_cast<float>(Point.Z));
+	const VectorRegister4Float RadiusSq = VectorSetFloat1(Radius * Radius);
+
+	const int32 Num = Anchors.Num();
+	const int32 PaddedNum = X.Num();
+	for (int32 i = 0; i < PaddedNum; i += 4)
+	{
+		const VectorRegister4Float DistSq = DistSquared4(&X[i], &Y[i], &Z[i], Px, Py, Pz);
+		int32 Mask = VectorMaskBits(VectorCompareLE(DistSq, RadiusSq));
+		while (Mask)
+		{
+			// A huge radius squares to infinity and lets the padding lanes through
+			const int32 Index = i + FMath::CountTrailingZeros(static_cast<uint32>(Mask));
+			if (Index < Num)
+			{
+				OutIndices.Add(Index);
+			}
+			Mask &= Mask - 1;
+		}
+	}
+}
+
+void FAnchorLocationCache::FindNearestBatch(TConstArrayView<FVector> Points, TArrayView<int32> OutIndices) const
+{
+	check(OutIndices.Num() >= Points.Num());
+
+	const int32 NumPoints = Points.Num();
+	if (Anchors.Num() == 0)
+	{
+		for (int32 q = 0; q < NumPoints; q++)
+		{
+			OutIndices[q] = INDEX_NONE;
+		}
+		return;
+	}
+
+	TArray<VectorRegister4Float> Best;
+	TArray<VectorRegister4Float> BestIndex;
+	Best.Init(VectorSetFloat1(MAX_flt), NumPoints);
+	BestIndex.Init(VectorSetFloat1(-1.f), NumPoints);
+
+	const VectorRegister4Float Step = VectorSetFloat1(4.f);
+	const int32 PaddedNum = X.Num();
+
+	for (int32 BlockStart = 0; BlockStart < PaddedNum; BlockStart += AnchorLocationCache::BatchBlockSize)
+	{
+		const int32 BlockEnd = FMath::Min(BlockStart + AnchorLocationCache::BatchBlockSize, PaddedNum);
+		const float BlockStartF = static_cast<float>(BlockStart);
+		const VectorRegister4Float BlockLaneIndex = MakeVectorRegisterFloat(BlockStartF, BlockStartF + 1.f, BlockStartF + 2.f, BlockStartF + 3.f);
+
+		for (int32 q = 0; q < NumPoints; q++)
+		{
+			const VectorRegister4Float Px = VectorSetFloat1(static_cast<float>(Points[q].X));
+			const VectorRegister4Float Py = VectorSetFloat1(static_cast<float>(Points[q].Y));
+			const VectorRegister4Float Pz = VectorSetFloat1(static_cast<float>(Points[q].Z));
+
+			VectorRegister4Float QueryBest = Best[q];
+			VectorRegister4Float QueryBestIndex = BestIndex[q];
+			VectorRegister4Float LaneIndex = BlockLaneIndex;
+
+			for (int32 i = BlockStart; i < BlockEnd; i += 4)
+			{
+				const VectorRegister4Float DistSq = DistSquared4(&X[i], &Y[i], &Z[i], Px, Py, Pz);
+				const VectorRegister4Float Closer = VectorCompareLT(DistSq, QueryBest);
+				QueryBest = VectorSelect(Closer, DistSq, QueryBest);
+				QueryBestIndex = VectorSelect(Closer, LaneIndex, QueryBestIndex);
+				LaneIndex = VectorAdd(LaneIndex, Step);
+			}
+
+			Best[q] = QueryBest;
+			BestIndex[q] = QueryBestIndex;
+		}
+	}
+
+	for (int32 q = 0; q < NumPoints; q++)
+	{
+		float DistSquared;
+		OutIndices[q] = ReduceNearest(Best[q], BestIndex[q], Anchors.Num(), DistSquared);
+	}
+}
@@ -1,18 +1,41 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "AnchorTeleportation.h"
+#include "TeleportAnchorValidator.h"
+#include "TeleportationStats.h"
+#include "TeleportTraceRecorder.h"
+
+DEFINE_STAT(STAT_TeleportRejectedRpcs);
+DEFINE_STAT(STAT_TeleportAnchorLookup);
+DEFINE_STAT(STAT_TeleportSpawnAfterImage);
+DEFINE_STAT(STAT_TeleportManagedPieces);
+DEFINE_STAT(STAT_TeleportPieceManagerTick);
+DEFINE_STAT(STAT_TeleportTimerWheelFired);
+DEFINE_STAT(STAT_TeleportTimerWheelEntries);
+DEFINE_STAT(STAT_TeleportPipelineTick);
+DEFINE_STAT(STAT_TeleportActivePipelines);
+DEFINE_STAT(STAT_TeleportStatePut);
+DEFINE_STAT(STAT_TeleportGating);
+DEFINE_STAT(STAT_TeleportMove);
 
 #define LOCTEXT_NAMESPACE "FAnchorTeleportationModule"
 
 void FAnchorTeleportationModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+#if WITH_EDITOR
+	FTeleportAnchorValidator::RegisterCookValidation();
+#endif
 }
 
 void FAnchorTeleportationModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FTeleportTraceRecorder::Get().Stop();
+#if WITH_EDITOR
+	FTeleportAnchorValidator::UnregisterCookValidation();
+#endif
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AnchorTeleportationReplicationGraph.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/PlayerController.h"
+#include "Pieces/BigTeleportationPiece.h"
+
+void UReplicationGraphNode_TeleportDestination::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	if (ReplicationActorList.Num() == 0) return;
+
+	if (FPlatformTime::Seconds() > ExpireTime)
+	{
+		ClearDestination();
+		return;
+	}
+
+	Params.OutGatheredReplicationLists.AddReplicationActorList(ReplicationActorList);
+}
+
+int32 UReplicationGraphNode_TeleportDestination::SetDestination(const FVector& Destination, float Radius, double InExpireTime,
+	const TArray<TObjectPtr<AActor>>& Candidates)
+{
+	ReplicationActorList.Reset();
+	ExpireTime = InExpireTime;
+
+	const double RadiusSquared = FMath::Square(Radius);
+	for (AActor* Actor : Candidates)
+	{
+		if (FVector::DistSquared(Actor->GetActorLocation(), Destination) <= RadiusSquared)
+		{
+			ReplicationActorList.Add(Actor);
+		}
+	}
+	return ReplicationActorList.Num();
+}
+
+void UReplicationGraphNode_TeleportDestination::ClearDestination()
+{
+	ReplicationActorList.Reset();
+}
+
+void UAnchorTeleportationReplicationGraph::InitGlobalGraphNodes()
+{
+	Super::InitGlobalGraphNodes();
+
+	GridNode->CellSize = GridCellSize;
+}
+
+void UAnchorTeleportationReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	UReplicationGraphNode_TeleportDestination* DestinationNode = CreateNewNode<UReplicationGraphNode_TeleportDestination>();
+	AddConnectionGraphNode(DestinationNode, RepGraphConnection);
+	DestinationNodes.Add(RepGraphConnection->NetConnection, DestinationNode);
+}
+
+void UAnchorTeleportationReplicationGraph::RemoveClientConnection(UNetConnection* NetConnection)
+{
+	DestinationNodes.Remove(NetConnection);
+
+	Super::RemoveClientConnection(NetConnection);
+}
+
+bool UAnchorTeleportationReplicationGraph::IsTeleportActor(const AActor* Actor)
+{
+	return Actor->IsA<ABigTeleportationPiece>();
+}
+
+void UAnchorTeleportationReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	// Sources never move, the grid keeps them in their cells without per-frame updates
+	if (IsTeleportActor(ActorInfo.Actor))
+	{
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		TeleportActors.Add(ActorInfo.Actor);
+		return;
+	}
+
+	Super::RouteAddNetworkActorToNodes(ActorInfo, GlobalInfo);
+}
+
+void UAnchorTeleportationReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	if (IsTeleportActor(ActorInfo.Actor))
+	{
+		GridNode->RemoveActor_Static(ActorInfo);
+		TeleportActors.RemoveSwap(ActorInfo.Actor);
+
+		// Pending lists may hold the actor, they are cheap to rebuild on the next teleport
+		for (TPair<TObjectPtr<UNetConnection>, TObjectPtr<UReplicationGraphNode_TeleportDestination>>& Pair : DestinationNodes)
+		{
+			Pair.Value->ClearDestination();
+		}
+		return;
+	}
+
+	Super::RouteRemoveNetworkActorToNodes(ActorInfo);
+}
+
+bool UAnchorTeleportationReplicationGraph::NotifyTeleportDestination(APlayerController* PlayerController, const FVector& Destination)
+{
+	UNetConnection* NetConnection = PlayerController ? PlayerController->GetNetConnection() : nullptr;
+	if (!NetConnection) return false;
+
+	UNetDriver* NetDriver = NetConnection->GetDriver();
+	UAnchorTeleportationReplicationGraph* Graph = NetDriver ? Cast<UAnchorTeleportationReplicationGraph>(NetDriver->GetReplicationDriver()) : nullptr;
+	if (!Graph) return false;
+
+	TObjectPtr<UReplicationGraphNode_TeleportDestination>* DestinationNode = Graph->DestinationNodes.Find(NetConnection);
+	if (!DestinationNode) return false;
+
+	return (*DestinationNode)->SetDestination(Destination, Graph->DestinationRadius,
+		FPlatformTime::Seconds() + Graph->DestinationHoldTime, Graph->TeleportActors) > 0;
+}
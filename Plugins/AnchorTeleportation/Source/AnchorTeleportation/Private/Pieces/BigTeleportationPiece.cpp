@@ -4,8 +4,17 @@
 #include "Pieces/BigTeleportationPiece.h"
 #include "TeleportationSubsystem.h"
 #include "Components/BoxComponent.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
 #include "GameFramework/Character.h"
+#include "GameFramework/GameStateBase.h"
 #include "Kismet/GameplayStatics.h"
+#include "Net/UnrealNetwork.h"
+#include "Pieces/TeleportationPieceManager.h"
+#include "TeleportationWorldSubsystem.h"
+#include "TeleportHitchDetector.h"
+#include "TeleportTraceRecorder.h"
+#include "TeleportTuning.h"
 
 // Sets default values
 ABigTeleportationPiece::ABigTeleportationPiece()
@@ -30,11 +39,34 @@ ABigTeleportationPiece::ABigTeleportationPiece()
 void ABigTeleportationPiece::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(ABigTeleportationPiece, ActiveBreaks);
+	DOREPLIFETIME(ABigTeleportationPiece, bSourceActive);
 }
 
 void ABigTeleportationPiece::BeginPlay()
 {
 	Super::BeginPlay();
+
+	// Clients spawn their own copies of the pieces, so everyone needs the class
+	if (!PieceClass.IsNull())
+	{
+		PieceClassHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(PieceClass.ToSoftObjectPath());
+	}
+}
+
+UClass* ABigTeleportationPiece::GetLoadedPieceClass()
+{
+	if (PieceClass.IsNull()) return nullptr;
+
+	UClass* LoadedClass = PieceClass.Get();
+	if (!LoadedClass)
+	{
+		// Pieces are gameplay state, so finish the load now rather than drop the break
+		UE_LOG(LogTemp, Warning, TEXT("PieceClass %s was not streamed in yet, loading synchronously"),
+			   *PieceClass.ToString());
+		LoadedClass = PieceClass.LoadSynchronous();
+	}
+	return LoadedClass;
 }
 
 void ABigTeleportationPiece::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor,
@@ -43,22 +75,30 @@ void ABigTeleportationPiece::OnHit(UPrimitiveComponent* HitComp, AActor* OtherAc
 	if (!OtherActor || !HasAuthority()) return;
 
 	// 🔹 Check if the hitting actor is in the AllowedColliders list
-	bool bIsAllowed = false;
-	for (TSubclassOf<AActor> AllowedType : AllowedColliders)
+	if (!IsAllowedCollider(OtherActor))
 	{
-		if (OtherActor->IsA(AllowedType))
-		{
-			bIsAllowed = true;
-			break;
-		}
+		UE_LOG(LogTemp, Verbose, TEXT("Collision ignored, actor %s is not allowed"),
+			   *OtherActor->GetName());
+		return;
 	}
 
-	if (!bIsAllowed)
+	const double Now = GetWorld()->GetTimeSeconds();
+	// At most one sweep per interval, however many actors keep hitting
+	if (LastHitTimes.Num() > 64 && Now - LastHitPruneTime >= HitThrottleInterval)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Collision ignored, actor %s is not allowed"),
-			   *OtherActor->GetName());
-		return;
+		LastHitPruneTime = Now;
+		for (auto It = LastHitTimes.CreateIterator(); It; ++It)
+		{
+			if (Now - It.Value() >= HitThrottleInterval)
+			{
+				It.RemoveCurrent();
+			}
+		}
 	}
+
+	double& LastHitTime = LastHitTimes.FindOrAdd(OtherActor, -HitThrottleInterval);
+	if (Now - LastHitTime < HitThrottleInterval) return;
+	LastHitTime = Now;
 	
 	APlayerController* InstigatorPlayer = nullptr;
 	FVector SpawnReferenceLocation = Hit.ImpactPoint;
@@ -86,36 +126,45 @@ void ABigTeleportationPiece::OnHit(UPrimitiveComponent* HitComp, AActor* OtherAc
 	ServerBreakSource(InstigatorPlayer, SpawnReferenceLocation);
 }
 
-void ABigTeleportationPiece::BreakSource(APlayerController* InstigatorPlayer, FVector SpawnReferenceLocation)
+bool ABigTeleportationPiece::IsAllowedCollider(const AActor* OtherActor)
 {
-	if (HasAuthority())
+	UClass* OtherClass = OtherActor->GetClass();
+	if (const bool* CachedVerdict = AllowedClassCache.Find(OtherClass))
 	{
-		if (!PieceClass) return;
-
-		UWorld* World = GetWorld();
-		if (!World) return;
+		return *CachedVerdict;
+	}
 
-	
-		int32 NumPieces = FMath::RandRange(1, MaxPieces);
-		
-		for (int32 i = 0; i < NumPieces; i++)
+	bool bIsAllowed = false;
+	for (const TSoftClassPtr<AActor>& AllowedType : AllowedColliders)
+	{
+		UClass* AllowedClass = AllowedType.Get();
+		if (AllowedClass && OtherClass->IsChildOf(AllowedClass))
 		{
-			FVector SafeSpawnLocation;
-			if (FindSafeSpawnLocation(SpawnReferenceLocation, SafeSpawnLocation))
-			{
-				ASmallTeleportationPieces* SmallPiece = World->SpawnActor<ASmallTeleportationPieces>(
-					PieceClass, SafeSpawnLocation, FRotator::ZeroRotator);
-
-				if (SmallPiece)
-				{
-					UE_LOG(LogTemp, Log, TEXT("Small Teleportation Piece Spawned at %s"), *SafeSpawnLocation.ToString());
-					
-					SmallPiece->SetReplicates(true);
-					SmallPiece->SetReplicateMovement(true);
-				}
-			}
+			bIsAllowed = true;
+			break;
 		}
-		DestroyAndRespawnSource();
+	}
+
+	// Only cache once every allowed class resolved, otherwise a later load could change the verdict
+	const bool bAllResolved = !AllowedColliders.ContainsByPredicate(
+		[](const TSoftClassPtr<AActor>& AllowedType) { return !AllowedType.IsNull() && !AllowedType.Get(); });
+	if (bIsAllowed || bAllResolved)
+	{
+		AllowedClassCache.Add(OtherClass, bIsAllowed);
+	}
+	return bIsAllowed;
+}
+
+void ABigTeleportationPiece::ResetAllowedColliderCache()
+{
+	AllowedClassCache.Reset();
+}
+
+void ABigTeleportationPiece::BreakSource(APlayerController* InstigatorPlayer, FVector SpawnReferenceLocation)
+{
+	if (HasAuthority())
+	{
+		StartBreak(InstigatorPlayer, SpawnReferenceLocation);
 	}
 	else
 	{
@@ -125,38 +174,184 @@ void ABigTeleportationPiece::BreakSource(APlayerController* InstigatorPlayer, FV
 
 void ABigTeleportationPiece::ServerBreakSource_Implementation(APlayerController* InstigatorPlayer, FVector SpawnReferenceLocation)
 {
-	if (!PieceClass) return;
+	GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>()->CountServerRpc(ETeleportServerRpc::BreakSource);
+	StartBreak(InstigatorPlayer, SpawnReferenceLocation);
+}
+
+void ABigTeleportationPiece::StartBreak(APlayerController* InstigatorPlayer, FVector SpawnReferenceLocation)
+{
+	if (!bSourceActive) return;
+
+	FTeleportTraceRecorder::Get().RecordBreak(FTeleportTraceRecorder::GetPlayerId(InstigatorPlayer), SpawnReferenceLocation);
+
+	if (bUsePieceManager)
+	{
+		AddPiecesToManager(SpawnReferenceLocation);
+		DeactivateAndScheduleRespawn();
+		return;
+	}
+
+	UClass* LoadedPieceClass = GetLoadedPieceClass();
+	if (!LoadedPieceClass) return;
 
 	UWorld* World = GetWorld();
 	if (!World) return;
-	
-	int32 NumPieces = FMath::RandRange(1, MaxPieces);
-	
+
+	FTeleportPieceBreak Break;
+	Break.BreakId = NextBreakId++;
+	Break.Seed = FMath::Rand();
+	Break.ReferenceLocation = SpawnReferenceLocation;
+	Break.StartTime = GetServerTime();
+	Break.DespawnTime = FTeleportTuning::GetDespawnTime(LoadedPieceClass->GetDefaultObject<ASmallTeleportationPieces>()->DespawnTime);
+	Break.NumPieces = static_cast<uint8>(FRandomStream(Break.Seed).RandRange(1, FMath::Clamp(FTeleportTuning::GetMaxPieces(MaxPieces), 1, 32)));
+
+	ActiveBreaks.Add(Break);
+	SpawnPiecesForBreak(ActiveBreaks.Last());
+
+	// Drop the event once its pieces have despawned everywhere
+	if (UTeleportationWorldSubsystem* WorldSubsystem = World->GetSubsystem<UTeleportationWorldSubsystem>())
+	{
+		WorldSubsystem->TimerWheel.Schedule(Break.DespawnTime,
+			FSimpleDelegate::CreateUObject(this, &ABigTeleportationPiece::ExpireBreak, Break.BreakId));
+	}
+
+	DeactivateAndScheduleRespawn();
+}
+
+void ABigTeleportationPiece::AddPiecesToManager(FVector SpawnReferenceLocation)
+{
+	UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>();
+	ATeleportationPieceManager* Manager = WorldSubsystem ? WorldSubsystem->GetOrSpawnPieceManager(PieceManagerClass) : nullptr;
+	if (!Manager) return;
+
+	FRandomStream RandomStream(FMath::Rand());
+	const int32 NumPieces = RandomStream.RandRange(1, FMath::Clamp(FTeleportTuning::GetMaxPieces(MaxPieces), 1, 32));
 	for (int32 i = 0; i < NumPieces; i++)
 	{
 		FVector SafeSpawnLocation;
-		if (FindSafeSpawnLocation(SpawnReferenceLocation, SafeSpawnLocation))
+		if (FindSafeSpawnLocation(RandomStream, SpawnReferenceLocation, SafeSpawnLocation))
+		{
+			Manager->AddPiece(SafeSpawnLocation);
+		}
+	}
+}
+
+void ABigTeleportationPiece::SpawnPiecesForBreak(const FTeleportPieceBreak& Break)
+{
+	UClass* LoadedPieceClass = GetLoadedPieceClass();
+	if (!LoadedPieceClass) return;
+
+	UWorld* World = GetWorld();
+	if (!World) return;
+
+	TArray<TWeakObjectPtr<ASmallTeleportationPieces>>& Spawned = LocalPieces.FindOrAdd(Break.BreakId);
+	Spawned.SetNum(Break.NumPieces);
+
+	// Nonzero when the break replicates to a client that joined after it started
+	const float SpawnAge = FMath::Max(static_cast<float>(GetServerTime() - Break.StartTime), 0.f);
+
+	for (int32 i = 0; i < Break.NumPieces; i++)
+	{
+		if (Break.CollectedMask & (1u << i)) continue;
+
+		// One stream per piece, so a trace that differs on one machine cannot shift the others
+		FRandomStream RandomStream(static_cast<int32>(HashCombine(static_cast<uint32>(Break.Seed), static_cast<uint32>(i))));
+
+		FVector SafeSpawnLocation;
+		if (!FindSafeSpawnLocation(RandomStream, Break.ReferenceLocation, SafeSpawnLocation)) continue;
+
+		ASmallTeleportationPieces* SmallPiece = World->SpawnActorDeferred<ASmallTeleportationPieces>(
+			LoadedPieceClass, FTransform(SafeSpawnLocation));
+		if (!SmallPiece) continue;
+
+		SmallPiece->SetReplicates(false);
+		SmallPiece->SourcePiece = this;
+		SmallPiece->BreakId = Break.BreakId;
+		SmallPiece->PieceIndex = i;
+		SmallPiece->SpawnAge = SpawnAge;
+		SmallPiece->DespawnTime = Break.DespawnTime;
+		SmallPiece->FinishSpawning(FTransform(SafeSpawnLocation));
+
+		Spawned[i] = SmallPiece;
+
+		UE_LOG(LogTemp, Log, TEXT("Small Teleportation Piece Spawned at %s"), *SafeSpawnLocation.ToString());
+	}
+}
+
+void ABigTeleportationPiece::MarkPieceCollected(int32 BreakId, int32 PieceIndex)
+{
+	FTeleportPieceBreak* Break = ActiveBreaks.FindByPredicate(
+		[BreakId](const FTeleportPieceBreak& Entry) { return Entry.BreakId == BreakId; });
+	if (!Break) return;
+
+	Break->CollectedMask |= 1u << PieceIndex;
+
+	const uint32 AllPieces = Break->NumPieces >= 32 ? MAX_uint32 : (1u << Break->NumPieces) - 1;
+	if ((Break->CollectedMask & AllPieces) == AllPieces)
+	{
+		ExpireBreak(BreakId);
+	}
+}
+
+void ABigTeleportationPiece::ExpireBreak(int32 BreakId)
+{
+	ActiveBreaks.RemoveAll([BreakId](const FTeleportPieceBreak& Entry) { return Entry.BreakId == BreakId; });
+	LocalPieces.Remove(BreakId);
+}
+
+double ABigTeleportationPiece::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
+void ABigTeleportationPiece::OnRep_ActiveBreaks()
+{
+	for (const FTeleportPieceBreak& Break : ActiveBreaks)
+	{
+		TArray<TWeakObjectPtr<ASmallTeleportationPieces>>* Spawned = LocalPieces.Find(Break.BreakId);
+		if (!Spawned)
 		{
-			ASmallTeleportationPieces* SmallPiece = World->SpawnActor<ASmallTeleportationPieces>(
-				PieceClass, SafeSpawnLocation, FRotator::ZeroRotator);
+			SpawnPiecesForBreak(Break);
+			continue;
+		}
 
-			if (SmallPiece)
+		for (int32 i = 0; i < Spawned->Num(); i++)
+		{
+			if ((Break.CollectedMask & (1u << i)) && (*Spawned)[i].IsValid())
 			{
-				UE_LOG(LogTemp, Log, TEXT("Small Teleportation Piece Spawned at %s"), *SafeSpawnLocation.ToString());
-				
-				SmallPiece->SetReplicates(true);
-				SmallPiece->SetReplicateMovement(true);
+				(*Spawned)[i]->Destroy();
 			}
 		}
 	}
-	DestroyAndRespawnSource();
+
+	// Events the server dropped have despawned or been collected, the local pieces go with them
+	for (auto It = LocalPieces.CreateIterator(); It; ++It)
+	{
+		const int32 BreakId = It.Key();
+		if (ActiveBreaks.ContainsByPredicate([BreakId](const FTeleportPieceBreak& Entry) { return Entry.BreakId == BreakId; }))
+		{
+			continue;
+		}
+
+		for (const TWeakObjectPtr<ASmallTeleportationPieces>& Piece : It.Value())
+		{
+			if (Piece.IsValid())
+			{
+				Piece->Destroy();
+			}
+		}
+		It.RemoveCurrent();
+	}
 }
 
-bool ABigTeleportationPiece::FindSafeSpawnLocation(FVector PlayerLocation, FVector& OutLocation)
+bool ABigTeleportationPiece::FindSafeSpawnLocation(FRandomStream& RandomStream, FVector PlayerLocation, FVector& OutLocation)
 {
 	UWorld* World = GetWorld();
 	if (!World) return false;
 
+	FTeleportHitchScope HitchScope(ETeleportHitchSection::PieceSpawnTrace);
+
 	const float MinDistance = 150.0f;
 	const float MaxDistance = 300.0f;
 	const float MaxSpawnHeightOffset = 30.0f;
@@ -164,10 +359,10 @@ bool ABigTeleportationPiece::FindSafeSpawnLocation(FVector PlayerLocation, FVect
 
 	for (int32 Attempt = 0; Attempt < 10; Attempt++)
 	{
-		FVector RandomDirection = FMath::VRand();
+		FVector RandomDirection = RandomStream.VRand();
 		RandomDirection.Z = 0;
 
-		FVector SpawnLocation = PlayerLocation + RandomDirection * FMath::RandRange(MinDistance, MaxDistance);
+		FVector SpawnLocation = PlayerLocation + RandomDirection * RandomStream.FRandRange(MinDistance, MaxDistance);
 		FVector TraceStart = SpawnLocation + FVector(0, 0, MaxSpawnHeightOffset);
 		FVector TraceEnd = SpawnLocation - FVector(0, 0, TraceDistance);
 		
@@ -175,7 +370,9 @@ bool ABigTeleportationPiece::FindSafeSpawnLocation(FVector PlayerLocation, FVect
 		FCollisionQueryParams TraceParams;
 		TraceParams.AddIgnoredActor(this);
 
-		bool bHit = World->LineTraceSingleByChannel(HitResult, TraceStart, TraceEnd, ECC_Visibility, TraceParams);
+		// Static geometry only, so server and clients see the same hits
+		bool bHit = World->LineTraceSingleByObjectType(HitResult, TraceStart, TraceEnd,
+			FCollisionObjectQueryParams(ECC_WorldStatic), TraceParams);
 
 		if (bHit && HitResult.bBlockingHit)
 		{
@@ -188,23 +385,31 @@ bool ABigTeleportationPiece::FindSafeSpawnLocation(FVector PlayerLocation, FVect
 	return false;
 }
 
-void ABigTeleportationPiece::DestroyAndRespawnSource()
+void ABigTeleportationPiece::DeactivateAndScheduleRespawn()
 {
 	UWorld* World = GetWorld();
 	if (!World) return;
 
-	FVector RespawnLocation = GetActorLocation();
-	FRotator RespawnRotation = GetActorRotation();
-	
-	FTimerHandle RespawnTimer;
-	World->GetTimerManager().SetTimer(RespawnTimer, [World, RespawnLocation, RespawnRotation, this]()
+	bSourceActive = false;
+	OnRep_SourceActive();
+
+	if (UTeleportationWorldSubsystem* WorldSubsystem = World->GetSubsystem<UTeleportationWorldSubsystem>())
 	{
-		ABigTeleportationPiece* NewPiece = World->SpawnActor<ABigTeleportationPiece>(GetClass(), RespawnLocation, RespawnRotation);
-		if (NewPiece)
-		{
-			UE_LOG(LogTemp, Log, TEXT("Big Teleportation Piece Respawned"));
-		}
-	}, RespawnTime, false);
-	
-	Destroy();
+		WorldSubsystem->TimerWheel.Schedule(FTeleportTuning::GetRespawnTime(RespawnTime),
+			FSimpleDelegate::CreateUObject(this, &ABigTeleportationPiece::RestoreSource));
+	}
+}
+
+void ABigTeleportationPiece::RestoreSource()
+{
+	bSourceActive = true;
+	OnRep_SourceActive();
+
+	UE_LOG(LogTemp, Log, TEXT("Big Teleportation Piece Respawned"));
+}
+
+void ABigTeleportationPiece::OnRep_SourceActive()
+{
+	SetActorHiddenInGame(!bSourceActive);
+	SetActorEnableCollision(bSourceActive);
 }
@@ -4,17 +4,18 @@
 #include "Pieces/SmallTeleportationPieces.h"
 
 #include "TeleportationSubsystem.h"
+#include "TeleportationWorldSubsystem.h"
+#include "TeleportTuning.h"
 #include "Components/BoxComponent.h"
 #include "Components/SphereComponent.h"
 #include "GameFramework/Character.h"
-#include "Net/UnrealNetwork.h"
 
 ASmallTeleportationPieces::ASmallTeleportationPieces()
 {
 	PrimaryActorTick.bCanEverTick = false;
 
-	bReplicates = true;
-	bAlwaysRelevant = true;
+	// Spawned locally on every machine from the source's break event
+	bReplicates = false;
 
 	MeshComponent = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("MeshComponent"));
 	SetRootComponent(MeshComponent);
@@ -31,23 +32,40 @@ ASmallTeleportationPieces::ASmallTeleportationPieces()
 	
 }
 
-void ASmallTeleportationPieces::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
-{
-	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	DOREPLIFETIME(ASmallTeleportationPieces, bIsCollected);
-}
-
 void ASmallTeleportationPieces::BeginPlay()
 {
 	Super::BeginPlay();
 
 	Collider->OnComponentBeginOverlap.AddDynamic(this, &ASmallTeleportationPieces::OnSphereOverlap);
 
-	FTimerHandle DespawnTimer;
-	GetWorld()->GetTimerManager().SetTimer(DespawnTimer, this, &ASmallTeleportationPieces::DestroyPiece, DespawnTime, false);
+	if (UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>())
+	{
+		// Pieces of a break already carry the server's tuned time
+		const float Lifetime = SourcePiece.IsValid() ? DespawnTime : FTeleportTuning::GetDespawnTime(DespawnTime);
+		DespawnTimer = WorldSubsystem->TimerWheel.Schedule(FMath::Max(Lifetime - SpawnAge, 0.f),
+			FSimpleDelegate::CreateUObject(this, &ASmallTeleportationPieces::DestroyPiece));
+
+		if (SpawnAge >= PickupDelay)
+		{
+			EnablePickup();
+		}
+		else
+		{
+			PickupDelayTimer = WorldSubsystem->TimerWheel.Schedule(PickupDelay - SpawnAge,
+				FSimpleDelegate::CreateUObject(this, &ASmallTeleportationPieces::EnablePickup));
+		}
+	}
+}
+
+void ASmallTeleportationPieces::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>())
+	{
+		WorldSubsystem->TimerWheel.Cancel(DespawnTimer);
+		WorldSubsystem->TimerWheel.Cancel(PickupDelayTimer);
+	}
 
-	FTimerHandle PickupDelayTimer;
-	GetWorld()->GetTimerManager().SetTimer(PickupDelayTimer, this, &ASmallTeleportationPieces::EnablePickup, 1.0f, false);
+	Super::EndPlay(EndPlayReason);
 }
 
 void ASmallTeleportationPieces::EnablePickup()
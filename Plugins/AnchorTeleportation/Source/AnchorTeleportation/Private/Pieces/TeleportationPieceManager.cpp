@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Pieces/TeleportationPieceManager.h"
+#include "TeleportationSubsystem.h"
+#include "TeleportationStats.h"
+#include "TeleportTraceRecorder.h"
+#include "TeleportTuning.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerController.h"
+#include "Net/UnrealNetwork.h"
+
+void FTeleportPieceState::PostReplicatedAdd(const FTeleportPieceStateArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->AddInstance(*this);
+	}
+}
+
+void FTeleportPieceState::PreReplicatedRemove(const FTeleportPieceStateArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->RemoveInstance(*this);
+	}
+}
+
+ATeleportationPieceManager::ATeleportationPieceManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickInterval = 0.1f;
+
+	bReplicates = true;
+	bAlwaysRelevant = true;
+
+	InstancedMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("InstancedMesh"));
+	SetRootComponent(InstancedMesh);
+	InstancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	InstancedMesh->SetRemoveSwap();
+
+	Pieces.Owner = this;
+}
+
+void ATeleportationPieceManager::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(ATeleportationPieceManager, Pieces);
+}
+
+void ATeleportationPieceManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Pieces.Owner = this;
+
+	// Clients only render, pickups and expiry are decided on the server
+	SetActorTickEnabled(HasAuthority());
+}
+
+void ATeleportationPieceManager::AddPiece(const FVector& Location)
+{
+	if (!HasAuthority()) return;
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	FTeleportPieceState& Piece = Pieces.Items.AddDefaulted_GetRef();
+	Piece.PieceId = NextPieceId++;
+	Piece.Location = Location;
+	Piece.PickupTime = Now + PickupDelay;
+	Piece.ExpireTime = Now + FTeleportTuning::GetDespawnTime(DespawnTime);
+	Pieces.MarkItemDirty(Piece);
+
+	if (GetNetMode() != NM_DedicatedServer)
+	{
+		AddInstance(Piece);
+	}
+
+	bGridDirty = true;
+	INC_DWORD_STAT(STAT_TeleportManagedPieces);
+}
+
+void ATeleportationPieceManager::RemovePieceAt(int32 ItemIndex)
+{
+	if (GetNetMode() != NM_DedicatedServer)
+	{
+		RemoveInstance(Pieces.Items[ItemIndex]);
+	}
+
+	Pieces.Items.RemoveAtSwap(ItemIndex);
+	Pieces.MarkArrayDirty();
+
+	bGridDirty = true;
+	DEC_DWORD_STAT(STAT_TeleportManagedPieces);
+}
+
+void ATeleportationPieceManager::AddInstance(const FTeleportPieceState& Piece)
+{
+	const int32 InstanceIndex = InstancedMesh->AddInstance(FTransform(Piece.Location), true);
+	InstancePieceIds.Add(Piece.PieceId);
+	PieceIdToInstance.Add(Piece.PieceId, InstanceIndex);
+}
+
+void ATeleportationPieceManager::RemoveInstance(const FTeleportPieceState& Piece)
+{
+	int32 InstanceIndex;
+	if (!PieceIdToInstance.RemoveAndCopyValue(Piece.PieceId, InstanceIndex)) return;
+
+	InstancedMesh->RemoveInstance(InstanceIndex);
+
+	// The component moved its last instance into the freed slot, mirror that
+	const int32 LastIndex = InstancePieceIds.Num() - 1;
+	if (InstanceIndex != LastIndex)
+	{
+		InstancePieceIds[InstanceIndex] = InstancePieceIds[LastIndex];
+		PieceIdToInstance[InstancePieceIds[InstanceIndex]] = InstanceIndex;
+	}
+	InstancePieceIds.Pop(EAllowShrinking::No);
+}
+
+FIntPoint ATeleportationPieceManager::GetCell(const FVector& Location) const
+{
+	const double CellSize = FMath::Max(PickupRadius * 2.0, 1.0);
+	return FIntPoint(FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize));
+}
+
+SIZE_T ATeleportationPieceManager::GetAllocatedSize() const
+{
+	SIZE_T Size = Pieces.Items.GetAllocatedSize() + Grid.GetAllocatedSize()
+		+ InstancePieceIds.GetAllocatedSize() + PieceIdToInstance.GetAllocatedSize();
+	for (const TPair<FIntPoint, TArray<int32>>& Cell : Grid)
+	{
+		Size += Cell.Value.GetAllocatedSize();
+	}
+	return Size;
+}
+
+void ATeleportationPieceManager::RebuildGrid()
+{
+	// Cells the pieces left would otherwise stay in the map forever
+	Grid.Reset();
+
+	for (int32 i = 0; i < Pieces.Items.Num(); i++)
+	{
+		Grid.FindOrAdd(GetCell(Pieces.Items[i].Location)).Add(i);
+	}
+
+	bGridDirty = false;
+}
+
+void ATeleportationPieceManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	SCOPE_CYCLE_COUNTER(STAT_TeleportPieceManagerTick);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	for (int32 i = Pieces.Items.Num() - 1; i >= 0; i--)
+	{
+		if (Pieces.Items[i].ExpireTime <= Now)
+		{
+			RemovePieceAt(i);
+		}
+	}
+
+	if (Pieces.Items.Num() > 0)
+	{
+		CollectOverlappingPieces(Now);
+	}
+}
+
+void ATeleportationPieceManager::CollectOverlappingPieces(double Now)
+{
+	if (bGridDirty)
+	{
+		RebuildGrid();
+	}
+
+	const double RadiusSquared = FMath::Square(PickupRadius);
+	TArray<int32> CollectedIndices;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		ACharacter* Character = PlayerController ? Cast<ACharacter>(PlayerController->GetPawn()) : nullptr;
+		if (!Character) continue;
+
+		UTeleportationSubsystem* TeleportSubsystem = Character->FindComponentByClass<UTeleportationSubsystem>();
+		if (!TeleportSubsystem) continue;
+
+		// Cells are twice the pickup radius, so the player's cell and its neighbours cover every candidate
+		const FVector PlayerLocation = Character->GetActorLocation();
+		const FIntPoint PlayerCell = GetCell(PlayerLocation);
+		for (int32 dx = -1; dx <= 1; dx++)
+		{
+			for (int32 dy = -1; dy <= 1; dy++)
+			{
+				const TArray<int32>* Cell = Grid.Find(PlayerCell + FIntPoint(dx, dy));
+				if (!Cell) continue;
+
+				for (int32 ItemIndex : *Cell)
+				{
+					const FTeleportPieceState& Piece = Pieces.Items[ItemIndex];
+					if (Piece.PickupTime > Now || CollectedIndices.Contains(ItemIndex)) continue;
+
+					if (FVector::DistSquared(PlayerLocation, Piece.Location) <= RadiusSquared)
+					{
+						CollectedIndices.Add(ItemIndex);
+						TeleportSubsystem->PickedUpPieces++;
+						FTeleportTraceRecorder::Get().RecordPickup(FTeleportTraceRecorder::GetPlayerId(PlayerController), Piece.Location);
+						TeleportSubsystem->SavePersistentState();
+					}
+				}
+			}
+		}
+	}
+
+	// Remove from the back so swapped-in items keep valid indices
+	CollectedIndices.Sort(TGreater<int32>());
+	for (int32 ItemIndex : CollectedIndices)
+	{
+		RemovePieceAt(ItemIndex);
+	}
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportAnchorRegistry.h"
+#include "Misc/ScopeLock.h"
+
+FTeleportAnchorRegistry::FTeleportAnchorRegistry()
+	: Current(new FSnapshotHolder(MakeShared<FTeleportAnchorTable>()))
+{
+}
+
+FTeleportAnchorRegistry::~FTeleportAnchorRegistry()
+{
+	// Readers hold their own references, only the holders are owned here
+	delete Current.load();
+	for (FSnapshotHolder* Holder : Retired)
+	{
+		delete Holder;
+	}
+	for (FSnapshotHolder* Holder : Draining)
+	{
+		delete Holder;
+	}
+}
+
+TSharedRef<const FTeleportAnchorTable> FTeleportAnchorRegistry::Read() const
+{
+	for (;;)
+	{
+		const uint32 ReadEpoch = Epoch.load();
+		std::atomic<int32>& Readers = ActiveReaders[ReadEpoch & 1];
+		Readers.fetch_add(1);
+
+		// Counted under a parity that was already flipped away, the reclaimer may not have seen us
+		if (Epoch.load() != ReadEpoch)
+		{
+			Readers.fetch_sub(1);
+			continue;
+		}
+
+		TSharedRef<const FTeleportAnchorTable> Snapshot = *Current.load();
+		Readers.fetch_sub(1);
+		return Snapshot;
+	}
+}
+
+void FTeleportAnchorRegistry::Publish(TSharedRef<const FTeleportAnchorTable> Snapshot)
+{
+	FScopeLock Lock(&WriteLock);
+
+	Retired.Add(Current.exchange(new FSnapshotHolder(MoveTemp(Snapshot))));
+	ReclaimLocked(Retired.Num() + Draining.Num() > MaxRetired);
+}
+
+void FTeleportAnchorRegistry::Reclaim()
+{
+	FScopeLock Lock(&WriteLock);
+	ReclaimLocked(false);
+}
+
+int32 FTeleportAnchorRegistry::NumRetired() const
+{
+	FScopeLock Lock(&WriteLock);
+	return Retired.Num() + Draining.Num();
+}
+
+void FTeleportAnchorRegistry::ReclaimLocked(bool bWait)
+{
+	if (Draining.Num() > 0)
+	{
+		// Every reader that could have loaded a draining holder started before the flip, under the old parity
+		std::atomic<int32>& OldReaders = ActiveReaders[(Epoch.load() + 1) & 1];
+		while (bWait && OldReaders.load() != 0)
+		{
+			FPlatformProcess::YieldThread();
+		}
+		if (OldReaders.load() != 0) return;
+
+		for (FSnapshotHolder* Holder : Draining)
+		{
+			delete Holder;
+		}
+		Draining.Reset();
+	}
+
+	if (Retired.Num() > 0)
+	{
+		Swap(Draining, Retired);
+		Epoch.fetch_add(1);
+	}
+}
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportAnchorTable.h"
+#include "Anchor.h"
+#include "Algo/StableSort.h"
+
+TSharedRef<const FTeleportAnchorTable> FTeleportAnchorTable::Build(TConstArrayView<AAnchor*> InAnchors)
+{
+	TSharedRef<FTeleportAnchorTable> Table = MakeShared<FTeleportAnchorTable>();
+
+	// Groups are numbered in order of their first anchor
+	TMap<FName, int32> GroupOfID;
+	TArray<TPair<int32, AAnchor*>> Sorted;
+	Sorted.Reserve(InAnchors.Num());
+	for (AAnchor* Anchor : InAnchors)
+	{
+		if (IsValid(Anchor))
+		{
+			Sorted.Emplace(GroupOfID.FindOrAdd(Anchor->AnchorID, GroupOfID.Num()), Anchor);
+		}
+	}
+	Algo::StableSortBy(Sorted, [](const TPair<int32, AAnchor*>& Entry) { return Entry.Key; });
+
+	FAnchorLocationCache& Locations = Table->Locations;
+	Locations.Anchors.Reserve(Sorted.Num());
+	Locations.GroupIndex.Reserve(Sorted.Num());
+	Table->AnchorIndices.Reserve(Sorted.Num());
+	Table->GroupStarts.Reserve(GroupOfID.Num() + 1);
+	for (int32 Index = 0; Index < Sorted.Num(); Index++)
+	{
+		if (Index == 0 || Sorted[Index].Key != Sorted[Index - 1].Key)
+		{
+			Table->GroupStarts.Add(Index);
+		}
+		Locations.Add(Sorted[Index].Value, Sorted[Index].Key);
+		Table->AnchorIndices.Add(Sorted[Index].Value, Index);
+	}
+	Table->GroupStarts.Add(Sorted.Num());
+	Locations.Finalize();
+
+	// Orphans are reported here once per build instead of on every teleport through them
+	int32 NumOrphans = 0;
+	Table->PairedIndex.Init(INDEX_NONE, Sorted.Num());
+	for (int32 Group = 0; Group < Table->NumGroups(); Group++)
+	{
+		const int32 Start = Table->GroupStarts[Group];
+		const int32 End = Table->GroupStarts[Group + 1];
+		if (End - Start < 2)
+		{
+			const AAnchor* Orphan = Locations.Anchors[Start];
+			if (!Orphan->IsRemote())
+			{
+				NumOrphans++;
+				UE_LOG(LogTemp, Verbose, TEXT("Anchor %s has no partner with ID %s"), *Orphan->GetName(), *Orphan->AnchorID.ToString());
+			}
+			continue;
+		}
+
+		for (int32 Index = Start; Index < End; Index++)
+		{
+			Table->PairedIndex[Index] = Index == Start ? Start + 1 : Start;
+		}
+	}
+	if (NumOrphans > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%d of %d anchor groups have a single anchor and cannot be teleported through"), NumOrphans, Table->NumGroups());
+	}
+
+	return Table;
+}
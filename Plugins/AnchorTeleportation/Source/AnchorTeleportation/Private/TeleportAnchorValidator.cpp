@@ -0,0 +1,223 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportAnchorValidator.h"
+
+#if WITH_EDITOR
+
+#include "Anchor.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "TeleportationWorldSubsystem.h"
+#include "UObject/ObjectSaveContext.h"
+#include "UObject/Package.h"
+#include "WorldPartition/WorldPartition.h"
+#include "WorldPartition/WorldPartitionActorDescInstance.h"
+#include "WorldPartition/WorldPartitionHelpers.h"
+
+#define LOCTEXT_NAMESPACE "TeleportAnchorValidator"
+
+namespace TeleportAnchorValidator
+{
+	int32 MaxGroupSize = 2;
+
+	FDelegateHandle PreSaveWorldHandle;
+
+	void ValidateCookedWorld(UWorld* World, FObjectPreSaveContext ObjectSaveContext)
+	{
+		// World Partition cells are saved as generated packages of their map, which is validated as a whole
+		if (!ObjectSaveContext.IsCooking() || !World || World->GetPackage()->GetName().Contains(TEXT("/_Generated_/"))) return;
+
+		// A validator of its own, the cooker's world has no subsystem that tracked anchors while they loaded. A partition
+		// lists every anchor in its actor descs, a level outside one may pair with anchors in another sublevel
+		const bool bComplete = World->GetWorldPartition() != nullptr;
+		FTeleportAnchorValidator Validator;
+		Validator.Rebuild(World);
+		const int32 NumIssues = Validator.Report(*GLog, bComplete ? ELogVerbosity::Error : ELogVerbosity::Warning);
+		if (NumIssues > 0)
+		{
+			UE_LOG(LogTemp, Display, TEXT("Cooked %s with %d anchor problems"), *World->GetPackage()->GetName(), NumIssues);
+		}
+	}
+}
+
+static FAutoConsoleVariableRef GTeleportValidateMaxGroupSizeCVar(
+	TEXT("teleport.validate.maxgroupsize"),
+	TeleportAnchorValidator::MaxGroupSize,
+	TEXT("Largest anchor group the editor accepts without a warning, raise it for groups that redirect to siblings"));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GTeleportValidateAnchorsCommand(
+	TEXT("teleport.validate.anchors"),
+	TEXT("Checks every anchor of the editor world for orphaned and oversize groups. Optional argument: rebuild"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		UTeleportationWorldSubsystem* WorldSubsystem = World ? World->GetSubsystem<UTeleportationWorldSubsystem>() : nullptr;
+		if (!WorldSubsystem) return;
+
+		FTeleportAnchorValidator& Validator = WorldSubsystem->GetAnchorValidator();
+		if (!Validator.IsBuilt() || (Args.Num() > 0 && Args[0] == TEXT("rebuild")))
+		{
+			Validator.Rebuild(World);
+		}
+		Validator.Report(Ar, ELogVerbosity::Warning);
+	}));
+
+const FName FTeleportAnchorValidator::AnchorIDProperty(TEXT("AnchorID"));
+const FName FTeleportAnchorValidator::RemoteProperty(TEXT("AnchorRemote"));
+
+int32 FTeleportAnchorValidator::GetMaxGroupSize()
+{
+	return TeleportAnchorValidator::MaxGroupSize;
+}
+
+void FTeleportAnchorValidator::RegisterCookValidation()
+{
+	TeleportAnchorValidator::PreSaveWorldHandle = FWorldDelegates::OnPreSaveWorldWithContext.AddStatic(&TeleportAnchorValidator::ValidateCookedWorld);
+}
+
+void FTeleportAnchorValidator::UnregisterCookValidation()
+{
+	FWorldDelegates::OnPreSaveWorldWithContext.Remove(TeleportAnchorValidator::PreSaveWorldHandle);
+}
+
+void FTeleportAnchorValidator::Update(const AAnchor* Anchor)
+{
+	if (!Anchor || Anchor->IsTemplate()) return;
+
+	Track(FSoftObjectPath(Anchor), Anchor->AnchorID, Anchor->IsRemote());
+}
+
+void FTeleportAnchorValidator::Remove(const AAnchor* Anchor)
+{
+	FAnchorRecord Record;
+	if (!Anchor || !Anchors.RemoveAndCopyValue(FSoftObjectPath(Anchor), Record)) return;
+
+	if (FGroup* Group = Groups.Find(Record.AnchorID))
+	{
+		Group->Members.RemoveSwap(FSoftObjectPath(Anchor));
+		DirtyGroups.Add(Record.AnchorID);
+	}
+}
+
+void FTeleportAnchorValidator::Track(const FSoftObjectPath& Path, FName AnchorID, bool bRemote)
+{
+	if (const FAnchorRecord* Existing = Anchors.Find(Path))
+	{
+		if (Existing->AnchorID == AnchorID && Existing->bRemote == bRemote) return;
+
+		if (FGroup* OldGroup = Groups.Find(Existing->AnchorID))
+		{
+			OldGroup->Members.RemoveSwap(Path);
+		}
+		DirtyGroups.Add(Existing->AnchorID);
+	}
+
+	Anchors.Add(Path, FAnchorRecord{ AnchorID, bRemote });
+	Groups.FindOrAdd(AnchorID).Members.Add(Path);
+	DirtyGroups.Add(AnchorID);
+}
+
+void FTeleportAnchorValidator::Rebuild(UWorld* World)
+{
+	Anchors.Reset();
+	Groups.Reset();
+	DirtyGroups.Reset();
+	bBuilt = true;
+	if (!World) return;
+
+	// Unloaded cells are read from the actor descs, AAnchor writes its ID there
+	if (UWorldPartition* WorldPartition = World->GetWorldPartition())
+	{
+		FWorldPartitionHelpers::ForEachActorDescInstance<AAnchor>(WorldPartition, [this](const FWorldPartitionActorDescInstance* ActorDesc)
+		{
+			FName AnchorID;
+			ActorDesc->GetProperty(AnchorIDProperty, &AnchorID);
+			Track(ActorDesc->GetActorSoftPath(), AnchorID, ActorDesc->HasProperty(RemoteProperty));
+			return true;
+		});
+	}
+
+	// Loaded actors may have unsaved edits, and levels outside the partition have no descs
+	for (TActorIterator<AAnchor> It(World); It; ++It)
+	{
+		Update(*It);
+	}
+}
+
+void FTeleportAnchorValidator::ValidateDirtyGroups()
+{
+	for (const FName AnchorID : DirtyGroups)
+	{
+		FGroup* Group = Groups.Find(AnchorID);
+		if (!Group) continue;
+
+		if (Group->Members.Num() == 0)
+		{
+			Groups.Remove(AnchorID);
+			continue;
+		}
+
+		Group->Issues.Reset();
+		if (AnchorID.IsNone())
+		{
+			Group->Issues.Add(FText::Format(LOCTEXT("NoAnchorID", "{0} anchors have no AnchorID"), Group->Members.Num()));
+			continue;
+		}
+
+		int32 NumRemote = 0;
+		for (const FSoftObjectPath& Member : Group->Members)
+		{
+			NumRemote += Anchors.FindChecked(Member).bRemote ? 1 : 0;
+		}
+		const int32 NumLocal = Group->Members.Num() - NumRemote;
+
+		if (NumRemote > 0 && NumLocal > 0)
+		{
+			Group->Issues.Add(FText::Format(LOCTEXT("MixedGroup", "Anchor group {0} mixes {1} remote and {2} local anchors"),
+				FText::FromName(AnchorID), NumRemote, NumLocal));
+		}
+		else if (NumLocal == 1)
+		{
+			Group->Issues.Add(FText::Format(LOCTEXT("Orphan", "Anchor group {0} has a single anchor, teleports through it will fail"),
+				FText::FromName(AnchorID)));
+		}
+		else if (NumLocal > GetMaxGroupSize())
+		{
+			Group->Issues.Add(FText::Format(LOCTEXT("Oversize", "Anchor group {0} has {1} anchors, more than the {2} allowed"),
+				FText::FromName(AnchorID), NumLocal, GetMaxGroupSize()));
+		}
+	}
+	DirtyGroups.Reset();
+}
+
+void FTeleportAnchorValidator::GetGroupIssues(const AAnchor* Anchor, TArray<FText>& OutIssues)
+{
+	ValidateDirtyGroups();
+
+	const FAnchorRecord* Record = Anchor ? Anchors.Find(FSoftObjectPath(Anchor)) : nullptr;
+	if (const FGroup* Group = Record ? Groups.Find(Record->AnchorID) : nullptr)
+	{
+		OutIssues.Append(Group->Issues);
+	}
+}
+
+int32 FTeleportAnchorValidator::Report(FOutputDevice& Ar, ELogVerbosity::Type Verbosity)
+{
+	ValidateDirtyGroups();
+
+	int32 NumIssues = 0;
+	for (const TPair<FName, FGroup>& Group : Groups)
+	{
+		for (const FText& Issue : Group.Value.Issues)
+		{
+			Ar.Logf(Verbosity, TEXT("%s (%s)"), *Issue.ToString(), *Group.Value.Members[0].ToString());
+			NumIssues++;
+		}
+	}
+	Ar.Logf(TEXT("Checked %d anchors in %d groups, %d problems"), Anchors.Num(), Groups.Num(), NumIssues);
+	return NumIssues;
+}
+
+#undef LOCTEXT_NAMESPACE
+
+#endif
@@ -0,0 +1,223 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportBotComponent.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Paths.h"
+#include "Pieces/BigTeleportationPiece.h"
+#include "Pieces/SmallTeleportationPieces.h"
+#include "Pieces/TeleportationPieceManager.h"
+#include "TeleportationSubsystem.h"
+
+// Load test tooling, shipping builds never start processes from the console or drive a pawn
+#if !UE_BUILD_SHIPPING
+namespace TeleportBots
+{
+	TArray<FProcHandle> LaunchedClients;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GTeleportBotsLaunchCommand(
+	TEXT("teleport.bots.launch"),
+	TEXT("Starts N headless client processes that join this server over loopback and play as bots. Usage: teleport.bots.launch N [teleport=1,break=1,pickup=1]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World || World->GetNetMode() == NM_Client || Args.Num() < 1) return;
+
+		const int32 Count = FCString::Atoi(*Args[0]);
+		const FString Mix = Args.Num() > 1 ? Args[1] : TEXT("teleport=1,break=1,pickup=1");
+
+#if WITH_EDITOR
+		// Editor binaries need the project and -game to run as a client
+		const FString ProjectArgs = FString::Printf(TEXT("\"%s\" -game "), *FPaths::GetProjectFilePath());
+#else
+		const FString ProjectArgs;
+#endif
+
+		for (int32 Index = 0; Index < Count; Index++)
+		{
+			const FString Params = FString::Printf(TEXT("%s127.0.0.1:%d -nullrhi -nosound -unattended -NoVerifyGC -log=TeleportBot%d.log -TeleportBot=%s"),
+				*ProjectArgs, World->URL.Port, TeleportBots::LaunchedClients.Num(), *Mix);
+			FProcHandle Handle = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Params, true, true, true, nullptr, 0, nullptr, nullptr);
+			if (Handle.IsValid())
+			{
+				TeleportBots::LaunchedClients.Add(Handle);
+			}
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("%d teleport bot clients running"), TeleportBots::LaunchedClients.Num());
+	}));
+
+static FAutoConsoleCommand GTeleportBotsStopCommand(
+	TEXT("teleport.bots.stop"),
+	TEXT("Terminates every bot client started with teleport.bots.launch"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (FProcHandle& Handle : TeleportBots::LaunchedClients)
+		{
+			FPlatformProcess::TerminateProc(Handle, true);
+			FPlatformProcess::CloseProc(Handle);
+		}
+		TeleportBots::LaunchedClients.Reset();
+	}));
+#endif
+
+UTeleportBotComponent::UTeleportBotComponent()
+{
+	PrimaryComponentTick.bCanEverTick = !UE_BUILD_SHIPPING;
+	PrimaryComponentTick.TickInterval = 0.1f;
+	Random.GenerateNewSeed();
+}
+
+bool UTeleportBotComponent::GetCommandLineMix(FString& OutMix)
+{
+#if UE_BUILD_SHIPPING
+	return false;
+#else
+	return FParse::Value(FCommandLine::Get(), TEXT("TeleportBot="), OutMix);
+#endif
+}
+
+void UTeleportBotComponent::SetBehaviorMix(const FString& Mix)
+{
+	FParse::Value(*Mix, TEXT("teleport="), TeleportWeight);
+	FParse::Value(*Mix, TEXT("break="), BreakWeight);
+	FParse::Value(*Mix, TEXT("pickup="), PickupWeight);
+}
+
+void UTeleportBotComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+#if !UE_BUILD_SHIPPING
+	APawn* Pawn = Cast<APawn>(GetOwner());
+	APlayerController* PlayerController = Pawn ? Cast<APlayerController>(Pawn->GetController()) : nullptr;
+	UTeleportationSubsystem* TeleportSubsystem = Pawn ? Pawn->FindComponentByClass<UTeleportationSubsystem>() : nullptr;
+	if (!PlayerController || !PlayerController->IsLocalController() || !TeleportSubsystem) return;
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	if (Now >= NextDecisionTime)
+	{
+		ChooseAction(Pawn);
+		NextDecisionTime = Now + DecisionInterval * Random.FRandRange(0.5f, 1.5f);
+	}
+
+	switch (Action)
+	{
+	case EBotAction::Teleport:
+		TeleportSubsystem->ClientRequestTeleport(PlayerController);
+		Action = EBotAction::Idle;
+		break;
+
+	case EBotAction::Break:
+	{
+		// Running into the source is what breaks it
+		const ABigTeleportationPiece* Source = Cast<ABigTeleportationPiece>(TargetActor.Get());
+		if (Source && Source->bSourceActive)
+		{
+			Pawn->AddMovementInput(Source->GetActorLocation() - Pawn->GetActorLocation());
+		}
+		else
+		{
+			Action = EBotAction::Idle;
+		}
+		break;
+	}
+
+	case EBotAction::Pickup:
+		if (TeleportSubsystem->Pieces)
+		{
+			TeleportSubsystem->CollectTeleportationPiece(PlayerController);
+			Action = EBotAction::Idle;
+		}
+		else if (FVector::DistSquared2D(Pawn->GetActorLocation(), TargetLocation) > FMath::Square(50.f))
+		{
+			Pawn->AddMovementInput(TargetLocation - Pawn->GetActorLocation());
+		}
+		else
+		{
+			Action = EBotAction::Idle;
+		}
+		break;
+
+	default:
+		break;
+	}
+#endif
+}
+
+#if !UE_BUILD_SHIPPING
+void UTeleportBotComponent::ChooseAction(APawn* Pawn)
+{
+	Action = EBotAction::Idle;
+	TargetActor.Reset();
+
+	const float TotalWeight = TeleportWeight + BreakWeight + PickupWeight;
+	if (TotalWeight <= 0.f) return;
+
+	float Roll = Random.FRandRange(0.f, TotalWeight);
+	if (Roll < TeleportWeight)
+	{
+		Action = EBotAction::Teleport;
+		return;
+	}
+	Roll -= TeleportWeight;
+
+	const FVector From = Pawn->GetActorLocation();
+	if (Roll < BreakWeight)
+	{
+		double BestDistSquared = MAX_dbl;
+		for (ABigTeleportationPiece* Source : TActorRange<ABigTeleportationPiece>(GetWorld()))
+		{
+			const double DistSquared = FVector::DistSquared(From, Source->GetActorLocation());
+			if (Source->bSourceActive && DistSquared < BestDistSquared)
+			{
+				BestDistSquared = DistSquared;
+				TargetActor = Source;
+			}
+		}
+		if (TargetActor.IsValid())
+		{
+			Action = EBotAction::Break;
+		}
+		return;
+	}
+
+	if (FindPickupTarget(From))
+	{
+		Action = EBotAction::Pickup;
+	}
+}
+
+bool UTeleportBotComponent::FindPickupTarget(const FVector& From)
+{
+	double BestDistSquared = MAX_dbl;
+	for (ASmallTeleportationPieces* Piece : TActorRange<ASmallTeleportationPieces>(GetWorld()))
+	{
+		const double DistSquared = FVector::DistSquared(From, Piece->GetActorLocation());
+		if (!Piece->bIsCollected && DistSquared < BestDistSquared)
+		{
+			BestDistSquared = DistSquared;
+			TargetLocation = Piece->GetActorLocation();
+		}
+	}
+
+	for (ATeleportationPieceManager* Manager : TActorRange<ATeleportationPieceManager>(GetWorld()))
+	{
+		for (const FTeleportPieceState& Piece : Manager->Pieces.Items)
+		{
+			const double DistSquared = FVector::DistSquared(From, Piece.Location);
+			if (DistSquared < BestDistSquared)
+			{
+				BestDistSquared = DistSquared;
+				TargetLocation = Piece.Location;
+			}
+		}
+	}
+
+	return BestDistSquared < MAX_dbl;
+}
+#endif
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportGatingPolicy.h"
+
+const FName FTeleportGatingPolicyRegistry::Cooldown(TEXT("Cooldown"));
+const FName FTeleportGatingPolicyRegistry::Charges(TEXT("Charges"));
+const FName FTeleportGatingPolicyRegistry::ChargesAndCooldown(TEXT("ChargesAndCooldown"));
+const FName FTeleportGatingPolicyRegistry::Unlimited(TEXT("Unlimited"));
+
+TMap<FName, FTeleportGatingPolicyRegistry::FFactory>& FTeleportGatingPolicyRegistry::GetFactories()
+{
+	// Built-ins go in on first use so registering from another static initializer is safe
+	static TMap<FName, FFactory> Factories = []()
+	{
+		TMap<FName, FFactory> BuiltIn;
+		BuiltIn.Add(TEXT("Cooldown"), []() -> TUniquePtr<ITeleportGatingPolicy> { return MakeUnique<FTeleportCooldownPolicy>(); });
+		BuiltIn.Add(TEXT("Charges"), []() -> TUniquePtr<ITeleportGatingPolicy> { return MakeUnique<FTeleportChargesPolicy>(); });
+		BuiltIn.Add(TEXT("ChargesAndCooldown"), []() -> TUniquePtr<ITeleportGatingPolicy> { return MakeUnique<FTeleportChargesAndCooldownPolicy>(); });
+		BuiltIn.Add(TEXT("Unlimited"), []() -> TUniquePtr<ITeleportGatingPolicy> { return MakeUnique<FTeleportUnlimitedPolicy>(); });
+		return BuiltIn;
+	}();
+	return Factories;
+}
+
+void FTeleportGatingPolicyRegistry::Register(FName PolicyName, FFactory Factory)
+{
+	check(IsInGameThread());
+	GetFactories().Add(PolicyName, MoveTemp(Factory));
+}
+
+void FTeleportGatingPolicyRegistry::Unregister(FName PolicyName)
+{
+	check(IsInGameThread());
+	GetFactories().Remove(PolicyName);
+}
+
+TUniquePtr<ITeleportGatingPolicy> FTeleportGatingPolicyRegistry::Create(FName PolicyName)
+{
+	const FFactory* Factory = GetFactories().Find(PolicyName);
+	return Factory ? (*Factory)() : nullptr;
+}
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportHandoff.h"
+#include "Engine/World.h"
+#include "UObject/Package.h"
+#include "UObject/UObjectGlobals.h"
+
+namespace TeleportHandoff
+{
+	TMap<FString, TWeakObjectPtr<UPackage>> PreloadedMaps;
+	TSet<FString> PendingPreloads;
+	TSet<FString> WantedMaps; // Preloads that finish loading after the pawn left their anchor are not kept
+	FString TravelURL;
+	double TravelStartTime = 0.0;
+}
+
+void FTeleportHandoff::PreloadDestination(const FString& MapPackageName)
+{
+	if (MapPackageName.IsEmpty()) return;
+
+	TeleportHandoff::WantedMaps.Add(MapPackageName);
+	if (IsPreloaded(MapPackageName) || TeleportHandoff::PendingPreloads.Contains(MapPackageName)) return;
+
+	TeleportHandoff::PendingPreloads.Add(MapPackageName);
+	LoadPackageAsync(MapPackageName, FLoadPackageAsyncDelegate::CreateLambda(
+		[](const FName& PackageName, UPackage* Package, EAsyncLoadingResult::Type Result)
+		{
+			TeleportHandoff::PendingPreloads.Remove(PackageName.ToString());
+			if (Result != EAsyncLoadingResult::Succeeded || !Package) return;
+			if (!TeleportHandoff::WantedMaps.Contains(PackageName.ToString()) && TeleportHandoff::TravelStartTime <= 0.0) return;
+
+			// Rooted so the garbage collection during travel does not throw the preload away
+			Package->AddToRoot();
+			TeleportHandoff::PreloadedMaps.Add(PackageName.ToString(), Package);
+			UE_LOG(LogTemp, Log, TEXT("Preloaded teleport destination %s"), *PackageName.ToString());
+		}));
+}
+
+void FTeleportHandoff::UpdatePreloads(const TSet<FString>& MapsInRange)
+{
+	if (TeleportHandoff::TravelStartTime <= 0.0)
+	{
+		for (auto It = TeleportHandoff::PreloadedMaps.CreateIterator(); It; ++It)
+		{
+			if (MapsInRange.Contains(It.Key())) continue;
+
+			if (UPackage* Package = It.Value().Get())
+			{
+				Package->RemoveFromRoot();
+			}
+			UE_LOG(LogTemp, Log, TEXT("Released preloaded teleport destination %s"), *It.Key());
+			It.RemoveCurrent();
+		}
+	}
+
+	TeleportHandoff::WantedMaps = MapsInRange;
+	for (const FString& MapPackageName : MapsInRange)
+	{
+		PreloadDestination(MapPackageName);
+	}
+}
+
+bool FTeleportHandoff::IsPreloaded(const FString& MapPackageName)
+{
+	const TWeakObjectPtr<UPackage>* Package = TeleportHandoff::PreloadedMaps.Find(MapPackageName);
+	return Package && Package->IsValid();
+}
+
+void FTeleportHandoff::BeginTravel(const FString& URL)
+{
+	TeleportHandoff::TravelURL = URL;
+	TeleportHandoff::TravelStartTime = FPlatformTime::Seconds();
+}
+
+void FTeleportHandoff::NotifyArrived(UWorld* World)
+{
+	if (TeleportHandoff::TravelStartTime > 0.0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Teleport handoff to %s took %.1f ms"), *TeleportHandoff::TravelURL,
+			(FPlatformTime::Seconds() - TeleportHandoff::TravelStartTime) * 1000.0);
+		TeleportHandoff::TravelStartTime = 0.0;
+	}
+
+	for (const TPair<FString, TWeakObjectPtr<UPackage>>& Entry : TeleportHandoff::PreloadedMaps)
+	{
+		if (UPackage* Package = Entry.Value.Get())
+		{
+			Package->RemoveFromRoot();
+		}
+	}
+	TeleportHandoff::PreloadedMaps.Reset();
+	TeleportHandoff::WantedMaps.Reset();
+}
@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportHitchDetector.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Policies/PrettyJsonPrintPolicy.h"
+#include "Serialization/JsonWriter.h"
+#include "Tasks/Task.h"
+
+namespace TeleportHitchDetector
+{
+	bool bEnabled = true;
+	float BudgetMs = 4.f;
+	float MinReportInterval = 10.f;
+}
+
+static FAutoConsoleVariableRef GTeleportHitchEnabledCVar(
+	TEXT("teleport.hitch.enabled"),
+	TeleportHitchDetector::bEnabled,
+	TEXT("Times the teleport sections every frame and reports frames over teleport.hitch.budgetms"));
+
+static FAutoConsoleVariableRef GTeleportHitchBudgetCVar(
+	TEXT("teleport.hitch.budgetms"),
+	TeleportHitchDetector::BudgetMs,
+	TEXT("Milliseconds the teleport sections may take in one frame before the frame is reported as a hitch"));
+
+static FAutoConsoleVariableRef GTeleportHitchIntervalCVar(
+	TEXT("teleport.hitch.interval"),
+	TeleportHitchDetector::MinReportInterval,
+	TEXT("Minimum seconds between two hitch reports, later hitches in the window are only counted"));
+
+const TCHAR* LexToString(ETeleportHitchSection Section)
+{
+	switch (Section)
+	{
+	case ETeleportHitchSection::AnchorScan: return TEXT("AnchorScan");
+	case ETeleportHitchSection::GhostSpawn: return TEXT("GhostSpawn");
+	case ETeleportHitchSection::GhostMaterial: return TEXT("GhostMaterial");
+	case ETeleportHitchSection::Move: return TEXT("Move");
+	case ETeleportHitchSection::PieceSpawnTrace: return TEXT("PieceSpawnTrace");
+	default: return TEXT("Unknown");
+	}
+}
+
+FTeleportHitchDetector& FTeleportHitchDetector::Get()
+{
+	static FTeleportHitchDetector Detector;
+	return Detector;
+}
+
+bool FTeleportHitchDetector::IsEnabled()
+{
+	return TeleportHitchDetector::bEnabled;
+}
+
+void FTeleportHitchDetector::EndFrame(const UWorld* World, const FTeleportHitchWorldCounts& Counts)
+{
+	check(IsInGameThread());
+
+	// Every ticking world calls in, the first one closes the frame
+	if (LastFrame == GFrameCounter) return;
+	LastFrame = GFrameCounter;
+
+	constexpr int32 NumSections = static_cast<int32>(ETeleportHitchSection::Num);
+	uint64 Cycles[NumSections];
+	uint32 Calls[NumSections];
+	uint64 TotalCycles = 0;
+	for (int32 Index = 0; Index < NumSections; Index++)
+	{
+		Cycles[Index] = SectionCycles[Index].exchange(0, std::memory_order_relaxed);
+		Calls[Index] = SectionCalls[Index].exchange(0, std::memory_order_relaxed);
+		TotalCycles += Cycles[Index];
+	}
+
+	const double TotalMs = FPlatformTime::ToMilliseconds64(TotalCycles);
+	if (!TeleportHitchDetector::bEnabled || TotalMs <= TeleportHitchDetector::BudgetMs) return;
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now - LastReportTime < TeleportHitchDetector::MinReportInterval)
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("Teleport hitch of %.2f ms not reported, last report was %.1f s ago"), TotalMs, Now - LastReportTime);
+		return;
+	}
+	LastReportTime = Now;
+
+	ReportHitch(World, Counts, Cycles, Calls, TotalMs);
+}
+
+void FTeleportHitchDetector::ReportHitch(const UWorld* World, const FTeleportHitchWorldCounts& Counts, const uint64 (&Cycles)[static_cast<int32>(ETeleportHitchSection::Num)],
+	const uint32 (&Calls)[static_cast<int32>(ETeleportHitchSection::Num)], double TotalMs)
+{
+	const FDateTime Timestamp = FDateTime::UtcNow();
+
+	FString Json;
+	TSharedRef<TJsonWriter<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>::Create(&Json);
+	Writer->WriteObjectStart();
+	Writer->WriteValue(TEXT("timestamp"), Timestamp.ToIso8601());
+	Writer->WriteValue(TEXT("frame"), static_cast<int64>(GFrameCounter));
+	Writer->WriteValue(TEXT("world"), World ? World->GetMapName() : FString());
+	Writer->WriteValue(TEXT("netMode"), World ? static_cast<int32>(World->GetNetMode()) : -1);
+	Writer->WriteValue(TEXT("budgetMs"), TeleportHitchDetector::BudgetMs);
+	Writer->WriteValue(TEXT("totalMs"), TotalMs);
+
+	FString Breakdown;
+	Writer->WriteObjectStart(TEXT("sections"));
+	for (int32 Index = 0; Index < static_cast<int32>(ETeleportHitchSection::Num); Index++)
+	{
+		const TCHAR* Name = LexToString(static_cast<ETeleportHitchSection>(Index));
+		const double Ms = FPlatformTime::ToMilliseconds64(Cycles[Index]);
+
+		Writer->WriteObjectStart(Name);
+		Writer->WriteValue(TEXT("ms"), Ms);
+		Writer->WriteValue(TEXT("calls"), static_cast<int32>(Calls[Index]));
+		Writer->WriteObjectEnd();
+
+		if (Calls[Index] > 0)
+		{
+			Breakdown += FString::Printf(TEXT(" %s=%.2fms/%u"), Name, Ms, Calls[Index]);
+		}
+	}
+	Writer->WriteObjectEnd();
+
+	Writer->WriteObjectStart(TEXT("worldCounts"));
+	Writer->WriteValue(TEXT("anchors"), Counts.Anchors);
+	Writer->WriteValue(TEXT("activeTeleports"), Counts.ActiveTeleports);
+	Writer->WriteValue(TEXT("ghosts"), Counts.Ghosts);
+	Writer->WriteValue(TEXT("freeGhostMaterials"), Counts.FreeGhostMaterials);
+	Writer->WriteValue(TEXT("pieces"), Counts.Pieces);
+	Writer->WriteObjectEnd();
+	Writer->WriteObjectEnd();
+	Writer->Close();
+
+	const FString Filename = FPaths::ProfilingDir() / TEXT("TeleportHitches") /
+		FString::Printf(TEXT("Hitch-%s-%llu.json"), *Timestamp.ToString(), static_cast<uint64>(GFrameCounter));
+
+	UE_LOG(LogTemp, Warning, TEXT("Teleport hitch: %.2f ms over a %.2f ms budget,%s (anchors %d, teleports %d, ghosts %d, pieces %d), see %s"),
+	       TotalMs, TeleportHitchDetector::BudgetMs, *Breakdown, Counts.Anchors, Counts.ActiveTeleports, Counts.Ghosts, Counts.Pieces, *Filename);
+
+	// Keep the file write off the frame that is already over budget
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [Json = MoveTemp(Json), Filename]()
+	{
+		FFileHelper::SaveStringToFile(Json, *Filename);
+	});
+}
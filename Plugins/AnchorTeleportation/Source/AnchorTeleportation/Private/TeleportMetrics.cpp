@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportMetrics.h"
+
+const TCHAR* LexToString(ETeleportRejectReason Reason)
+{
+	switch (Reason)
+	{
+	case ETeleportRejectReason::RateLimited: return TEXT("RateLimited");
+	case ETeleportRejectReason::NoPawn: return TEXT("NoPawn");
+	case ETeleportRejectReason::AlreadyTeleporting: return TEXT("AlreadyTeleporting");
+	case ETeleportRejectReason::Gated: return TEXT("Gated");
+	case ETeleportRejectReason::NoAnchor: return TEXT("NoAnchor");
+	case ETeleportRejectReason::QueueTimeout: return TEXT("QueueTimeout");
+	case ETeleportRejectReason::Other: return TEXT("Other");
+	default: return TEXT("Unknown");
+	}
+}
+
+uint64 FTeleportRollingCounter::Sum(int32 Seconds) const
+{
+	check(Seconds < NumBuckets);
+
+	const uint64 Now = static_cast<uint64>(FPlatformTime::Seconds());
+	uint64 Result = 0;
+	for (const FBucket& Bucket : Buckets)
+	{
+		const uint64 BucketSecond = Bucket.Second.load(std::memory_order_relaxed);
+		if (BucketSecond < Now && BucketSecond + Seconds >= Now)
+		{
+			Result += Bucket.Value.load(std::memory_order_relaxed);
+		}
+	}
+	return Result;
+}
+
+FTeleportMetrics& FTeleportMetrics::Get()
+{
+	static FTeleportMetrics Metrics;
+	return Metrics;
+}
+
+void FTeleportMetrics::Dump(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("  Teleports: %.2f/s over the last %d s, %llu total"),
+		static_cast<double>(Teleports.Sum(WindowSeconds)) / WindowSeconds, WindowSeconds, Teleports.GetTotal());
+
+	FString RejectLine;
+	for (int32 Index = 0; Index < static_cast<int32>(ETeleportRejectReason::Num); Index++)
+	{
+		const FTeleportRollingCounter& Counter = Rejects[Index];
+		if (Counter.GetTotal() == 0) continue;
+
+		RejectLine += FString::Printf(TEXT(" %s %.2f/s (%llu),"), LexToString(static_cast<ETeleportRejectReason>(Index)),
+			static_cast<double>(Counter.Sum(WindowSeconds)) / WindowSeconds, Counter.GetTotal());
+	}
+	RejectLine.RemoveFromEnd(TEXT(","));
+	Ar.Logf(TEXT("  Rejected:%s"), RejectLine.IsEmpty() ? TEXT(" none") : *RejectLine);
+
+	const uint64 Lookups = AnchorLookups.Sum(WindowSeconds);
+	Ar.Logf(TEXT("  Anchor lookup: avg %.3f ms over %llu lookups in the last %d s"),
+		Lookups > 0 ? FPlatformTime::ToMilliseconds64(AnchorLookupCycles.Sum(WindowSeconds)) / Lookups : 0.0, Lookups, WindowSeconds);
+}
@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportPersistenceSubsystem.h"
+#include "Engine/GameInstance.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include "TeleportationStats.h"
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GTeleportPersistenceStatsCommand(
+	TEXT("teleport.persistence.stats"),
+	TEXT("Prints cache size, queued writes and load latency of the teleport state store"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+		if (UTeleportPersistenceSubsystem* Persistence = GameInstance ? GameInstance->GetSubsystem<UTeleportPersistenceSubsystem>() : nullptr)
+		{
+			Persistence->DumpStats(Ar);
+		}
+	}));
+
+void UTeleportPersistenceSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Store = MakeShared<FTeleportFileStateStore>(FPaths::ProjectSavedDir() / TEXT("TeleportState"));
+	FlushTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+		FTickerDelegate::CreateUObject(this, &UTeleportPersistenceSubsystem::TickFlush), FlushInterval);
+}
+
+void UTeleportPersistenceSubsystem::Deinitialize()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(FlushTickerHandle);
+	FlushPendingWrites();
+	Store->WaitForPendingSaves();
+
+	Super::Deinitialize();
+}
+
+void UTeleportPersistenceSubsystem::SetStore(TSharedRef<ITeleportStateStore> InStore)
+{
+	FlushPendingWrites();
+	Store = InStore;
+	Cache.Reset();
+}
+
+FString UTeleportPersistenceSubsystem::GetPlayerKey(const AController* Controller)
+{
+	const APlayerState* PlayerState = Controller ? Controller->PlayerState : nullptr;
+	if (!PlayerState) return FString();
+
+	const FUniqueNetIdRepl& NetId = PlayerState->GetUniqueId();
+	return NetId.IsValid() ? NetId.ToString() : PlayerState->GetPlayerName();
+}
+
+void UTeleportPersistenceSubsystem::Get(const FString& PlayerKey, TFunction<void(TOptional<FTeleportPlayerState>)> OnLoaded)
+{
+	if (const FTeleportPlayerState* Cached = Cache.Find(PlayerKey))
+	{
+		OnLoaded(*Cached);
+		return;
+	}
+
+	const double RequestTime = FPlatformTime::Seconds();
+	Store->Load(PlayerKey, [WeakThis = TWeakObjectPtr<UTeleportPersistenceSubsystem>(this), PlayerKey, RequestTime, OnLoaded = MoveTemp(OnLoaded)](TOptional<FTeleportPlayerState> State)
+	{
+		if (UTeleportPersistenceSubsystem* This = WeakThis.Get())
+		{
+			const double Seconds = FPlatformTime::Seconds() - RequestTime;
+			This->NumLoads++;
+			This->TotalLoadSeconds += Seconds;
+			This->MaxLoadSeconds = FMath::Max(This->MaxLoadSeconds, Seconds);
+
+			// A Put that raced the load is newer than what the store had
+			if (const FTeleportPlayerState* Cached = This->Cache.Find(PlayerKey))
+			{
+				State = *Cached;
+			}
+			else if (State.IsSet())
+			{
+				This->Cache.Add(PlayerKey, State.GetValue());
+			}
+		}
+		OnLoaded(State);
+	});
+}
+
+void UTeleportPersistenceSubsystem::Put(const FString& PlayerKey, const FTeleportPlayerState& State)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TeleportStatePut);
+
+	if (PlayerKey.IsEmpty()) return;
+
+	// What every teleport pays for persistence, the store itself is off the game thread
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	Cache.Add(PlayerKey, State);
+	PendingWrites.Add(PlayerKey, State);
+
+	const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+	NumPuts++;
+	TotalPutSeconds += Seconds;
+	MaxPutSeconds = FMath::Max(MaxPutSeconds, Seconds);
+}
+
+void UTeleportPersistenceSubsystem::RecordHandoffWait(double Seconds)
+{
+	NumHandoffs++;
+	TotalHandoffSeconds += Seconds;
+	MaxHandoffSeconds = FMath::Max(MaxHandoffSeconds, Seconds);
+}
+
+bool UTeleportPersistenceSubsystem::TickFlush(float DeltaTime)
+{
+	FlushPendingWrites();
+	return true;
+}
+
+UE::Tasks::FTask UTeleportPersistenceSubsystem::FlushPendingWrites()
+{
+	if (PendingWrites.Num() == 0) return UE::Tasks::FTask();
+
+	NumWrites += PendingWrites.Num();
+	UE::Tasks::FTask Save = Store->SaveBatch(PendingWrites.Array());
+	PendingWrites.Reset();
+	return Save;
+}
+
+void UTeleportPersistenceSubsystem::Evict(const FString& PlayerKey)
+{
+	// An unflushed write is newer than the store, the cache has to keep answering with it
+	if (!PendingWrites.Contains(PlayerKey))
+	{
+		Cache.Remove(PlayerKey);
+	}
+}
+
+void UTeleportPersistenceSubsystem::DumpStats(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("Teleport state: %d cached players, %d queued writes, %d written"), Cache.Num(), PendingWrites.Num(), NumWrites);
+	Ar.Logf(TEXT("  Store loads: %d, avg %.2f ms, max %.2f ms"), NumLoads,
+		NumLoads > 0 ? TotalLoadSeconds * 1000.0 / NumLoads : 0.0, MaxLoadSeconds * 1000.0);
+	Ar.Logf(TEXT("  Per teleport: %d puts, avg %.2f us, max %.2f us"), NumPuts,
+		NumPuts > 0 ? TotalPutSeconds * 1.0e6 / NumPuts : 0.0, MaxPutSeconds * 1.0e6);
+	Ar.Logf(TEXT("  Per server travel: %d handoff saves, avg %.2f ms, max %.2f ms"), NumHandoffs,
+		NumHandoffs > 0 ? TotalHandoffSeconds * 1000.0 / NumHandoffs : 0.0, MaxHandoffSeconds * 1000.0);
+}
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportStateStore.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace TeleportStateStore
+{
+	constexpr uint32 FileVersion = 2; // 2 added the pending arrival
+}
+
+FTeleportFileStateStore::FTeleportFileStateStore(const FString& InDirectory)
+	: Directory(InDirectory)
+{
+	IFileManager::Get().MakeDirectory(*Directory, true);
+}
+
+FString FTeleportFileStateStore::GetFilename(const FString& PlayerKey) const
+{
+	// Net ids can hold characters that are not valid in file names
+	return Directory / FMD5::HashAnsiString(*PlayerKey) + TEXT(".bin");
+}
+
+void FTeleportFileStateStore::Load(const FString& PlayerKey, TFunction<void(TOptional<FTeleportPlayerState>)> OnLoaded)
+{
+	Pipe.Launch(UE_SOURCE_LOCATION, [Filename = GetFilename(PlayerKey), OnLoaded = MoveTemp(OnLoaded)]() mutable
+	{
+		TOptional<FTeleportPlayerState> State;
+
+		TArray<uint8> Data;
+		if (FFileHelper::LoadFileToArray(Data, *Filename, FILEREAD_Silent))
+		{
+			FMemoryReader Ar(Data);
+			uint32 Version = 0;
+			FTeleportPlayerState Loaded;
+			Ar << Version;
+			if (Version >= 1 && Version <= TeleportStateStore::FileVersion)
+			{
+				Ar << Loaded.Charges << Loaded.LastTeleportUtc;
+				if (Version >= 2)
+				{
+					FString PendingArrivalAnchor;
+					Ar << PendingArrivalAnchor << Loaded.PendingArrivalUtc;
+					Loaded.PendingArrivalAnchor = FName(*PendingArrivalAnchor);
+				}
+				if (!Ar.IsError())
+				{
+					State = Loaded;
+				}
+			}
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [OnLoaded = MoveTemp(OnLoaded), State]()
+		{
+			OnLoaded(State);
+		});
+	});
+}
+
+UE::Tasks::FTask FTeleportFileStateStore::SaveBatch(TArray<TPair<FString, FTeleportPlayerState>> States)
+{
+	if (States.Num() == 0) return UE::Tasks::FTask();
+
+	for (TPair<FString, FTeleportPlayerState>& Entry : States)
+	{
+		Entry.Key = GetFilename(Entry.Key);
+	}
+
+	LastSave = Pipe.Launch(UE_SOURCE_LOCATION, [States = MoveTemp(States)]()
+	{
+		for (const TPair<FString, FTeleportPlayerState>& Entry : States)
+		{
+			TArray<uint8> Data;
+			FMemoryWriter Ar(Data);
+			uint32 Version = TeleportStateStore::FileVersion;
+			FTeleportPlayerState State = Entry.Value;
+			FString PendingArrivalAnchor = State.PendingArrivalAnchor.ToString();
+			Ar << Version << State.Charges << State.LastTeleportUtc << PendingArrivalAnchor << State.PendingArrivalUtc;
+
+			if (!FFileHelper::SaveArrayToFile(Data, *Entry.Key))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Failed to save teleport state to %s"), *Entry.Key);
+			}
+		}
+	});
+	return LastSave;
+}
+
+void FTeleportFileStateStore::WaitForPendingSaves()
+{
+	LastSave.Wait();
+}
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportTimerWheel.h"
+
+FTeleportTimerWheel::FTeleportTimerWheel(double InTickSeconds, int32 InNumSlots)
+	: TickSeconds(InTickSeconds)
+{
+	check(InTickSeconds > 0.0 && InNumSlots > 0);
+	Slots.SetNum(InNumSlots);
+}
+
+FTeleportTimerHandle FTeleportTimerWheel::Schedule(double Delay, FSimpleDelegate Callback)
+{
+	// Due on the first tick boundary at or after the delay, never on the tick being processed
+	const int64 Ticks = FMath::Max<int64>(1, FMath::CeilToInt64((Delay + Accumulator) / TickSeconds));
+	const int32 NumSlots = Slots.Num();
+
+	FEntry Entry;
+	Entry.Callback = MoveTemp(Callback);
+	Entry.Serial = NextSerial++;
+	Entry.Rounds = static_cast<int32>((Ticks - 1) / NumSlots);
+
+	FTeleportTimerHandle Handle;
+	Handle.Index = Entries.Add(MoveTemp(Entry));
+	Handle.Serial = Entries[Handle.Index].Serial;
+
+	Slots[(CurrentTick + Ticks) % NumSlots].Add({ Handle.Index, Handle.Serial });
+	return Handle;
+}
+
+void FTeleportTimerWheel::Cancel(FTeleportTimerHandle& Handle)
+{
+	// The slot keeps a stale reference, the serial check skips it when the slot comes round
+	if (Handle.IsValid() && Entries.IsValidIndex(Handle.Index) && Entries[Handle.Index].Serial == Handle.Serial)
+	{
+		Entries.RemoveAt(Handle.Index);
+	}
+	Handle.Invalidate();
+}
+
+int32 FTeleportTimerWheel::Advance(double DeltaSeconds)
+{
+	int32 NumFired = 0;
+	Accumulator += DeltaSeconds;
+
+	while (Accumulator >= TickSeconds)
+	{
+		Accumulator -= TickSeconds;
+		CurrentTick++;
+
+		TArray<FSlotEntry>& Slot = Slots[CurrentTick % Slots.Num()];
+		for (int32 i = Slot.Num() - 1; i >= 0; i--)
+		{
+			const FSlotEntry SlotEntry = Slot[i];
+			if (!Entries.IsValidIndex(SlotEntry.Index) || Entries[SlotEntry.Index].Serial != SlotEntry.Serial)
+			{
+				Slot.RemoveAtSwap(i, 1, EAllowShrinking::No);
+				continue;
+			}
+
+			FEntry& Entry = Entries[SlotEntry.Index];
+			if (Entry.Rounds > 0)
+			{
+				Entry.Rounds--;
+				continue;
+			}
+
+			DueCallbacks.Add(MoveTemp(Entry.Callback));
+			Entries.RemoveAt(SlotEntry.Index);
+			Slot.RemoveAtSwap(i, 1, EAllowShrinking::No);
+		}
+
+		// Fire after the slot is settled, callbacks are free to schedule or cancel
+		for (FSimpleDelegate& Callback : DueCallbacks)
+		{
+			Callback.ExecuteIfBound();
+		}
+		NumFired += DueCallbacks.Num();
+		DueCallbacks.Reset();
+	}
+
+	return NumFired;
+}
+
+SIZE_T FTeleportTimerWheel::GetAllocatedSize() const
+{
+	SIZE_T Size = Entries.GetAllocatedSize() + Slots.GetAllocatedSize() + DueCallbacks.GetAllocatedSize();
+	for (const TArray<FSlotEntry>& Slot : Slots)
+	{
+		Size += Slot.GetAllocatedSize();
+	}
+	return Size;
+}
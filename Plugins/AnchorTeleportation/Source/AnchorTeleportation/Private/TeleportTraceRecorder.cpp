@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportTraceRecorder.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace TeleportTraceRecorder
+{
+	constexpr int32 FlushThreshold = 64 * 1024;
+}
+
+static FAutoConsoleCommand GTeleportTraceStartCommand(
+	TEXT("teleport.trace.start"),
+	TEXT("Starts recording teleport traffic on this server. Optional argument: output file"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const FString Filename = Args.Num() > 0 ? Args[0] : FPaths::ProfilingDir() /
+			FString::Printf(TEXT("TeleportTrace-%s.bin"), *FDateTime::Now().ToString());
+		if (FTeleportTraceRecorder::Get().Start(Filename))
+		{
+			UE_LOG(LogTemp, Log, TEXT("Recording teleport trace to %s"), *Filename);
+		}
+	}));
+
+static FAutoConsoleCommand GTeleportTraceStopCommand(
+	TEXT("teleport.trace.stop"),
+	TEXT("Stops recording teleport traffic"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FTeleportTraceRecorder::Get().Stop();
+	}));
+
+FTeleportTraceRecorder& FTeleportTraceRecorder::Get()
+{
+	static FTeleportTraceRecorder Recorder;
+	return Recorder;
+}
+
+bool FTeleportTraceRecorder::Start(const FString& Filename)
+{
+	Stop();
+
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Writer)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to open teleport trace file %s"), *Filename);
+		return false;
+	}
+
+	uint32 FileMagic = Magic;
+	uint32 FileVersion = Version;
+	*Writer << FileMagic << FileVersion;
+
+	StartTime = FPlatformTime::Seconds();
+	AnchorIndices.Reset();
+	Buffer.Reset();
+	return true;
+}
+
+void FTeleportTraceRecorder::Stop()
+{
+	if (!Writer) return;
+
+	Flush();
+	Writer->Close();
+	Writer.Reset();
+}
+
+uint32 FTeleportTraceRecorder::GetPlayerId(const AController* Controller)
+{
+	return Controller && Controller->PlayerState ? static_cast<uint32>(Controller->PlayerState->GetPlayerId()) : 0;
+}
+
+void FTeleportTraceRecorder::WriteRecordHeader(ETeleportTraceEvent Type, uint32 PlayerId, const FVector& Position)
+{
+	FMemoryWriter Ar(Buffer);
+	Ar.Seek(Buffer.Num());
+
+	uint8 TypeByte = static_cast<uint8>(Type);
+	float Time = static_cast<float>(FPlatformTime::Seconds() - StartTime);
+	FVector3f Position3f(Position);
+	Ar << TypeByte << Time << PlayerId << Position3f;
+}
+
+int32 FTeleportTraceRecorder::GetAnchorIndex(FName AnchorID)
+{
+	if (const int32* Index = AnchorIndices.Find(AnchorID))
+	{
+		return *Index;
+	}
+
+	int32 Index = AnchorIndices.Num();
+	AnchorIndices.Add(AnchorID, Index);
+
+	FMemoryWriter Ar(Buffer);
+	Ar.Seek(Buffer.Num());
+	uint8 TypeByte = static_cast<uint8>(ETeleportTraceEvent::AnchorName);
+	FString Name = AnchorID.ToString();
+	Ar << TypeByte << Index << Name;
+	return Index;
+}
+
+void FTeleportTraceRecorder::RecordTeleport(uint32 PlayerId, const FVector& Position, FName SourceAnchor, FName TargetAnchor)
+{
+	if (!Writer) return;
+
+	int32 SourceIndex = GetAnchorIndex(SourceAnchor);
+	int32 TargetIndex = GetAnchorIndex(TargetAnchor);
+	WriteRecordHeader(ETeleportTraceEvent::Teleport, PlayerId, Position);
+
+	FMemoryWriter Ar(Buffer);
+	Ar.Seek(Buffer.Num());
+	Ar << SourceIndex << TargetIndex;
+
+	FlushIfFull();
+}
+
+void FTeleportTraceRecorder::RecordBreak(uint32 PlayerId, const FVector& Position)
+{
+	if (!Writer) return;
+
+	WriteRecordHeader(ETeleportTraceEvent::Break, PlayerId, Position);
+	FlushIfFull();
+}
+
+void FTeleportTraceRecorder::RecordPickup(uint32 PlayerId, const FVector& Position)
+{
+	if (!Writer) return;
+
+	WriteRecordHeader(ETeleportTraceEvent::Pickup, PlayerId, Position);
+	FlushIfFull();
+}
+
+void FTeleportTraceRecorder::FlushIfFull()
+{
+	if (Buffer.Num() >= TeleportTraceRecorder::FlushThreshold)
+	{
+		Flush();
+	}
+}
+
+void FTeleportTraceRecorder::Flush()
+{
+	if (Writer && Buffer.Num() > 0)
+	{
+		Writer->Serialize(Buffer.GetData(), Buffer.Num());
+	}
+	Buffer.Reset();
+}
+
+bool FTeleportTraceRecorder::ReadTrace(const FString& Filename, TArray<FTeleportTraceRecord>& OutRecords)
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Filename))
+	{
+		return false;
+	}
+
+	FMemoryReader Ar(Data);
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	Ar << FileMagic << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is not a teleport trace of version %u"), *Filename, Version);
+		return false;
+	}
+
+	TArray<FName> AnchorNames;
+	while (!Ar.AtEnd() && !Ar.IsError())
+	{
+		uint8 TypeByte = 0;
+		Ar << TypeByte;
+
+		// Replayers index per-type arrays with this, a corrupt or foreign file must not get past here
+		if (TypeByte > static_cast<uint8>(ETeleportTraceEvent::Pickup))
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s has an unknown event type %u at offset %lld"), *Filename, TypeByte, Ar.Tell() - 1);
+			return false;
+		}
+
+		const ETeleportTraceEvent Type = static_cast<ETeleportTraceEvent>(TypeByte);
+		if (Type == ETeleportTraceEvent::AnchorName)
+		{
+			int32 Index = 0;
+			FString Name;
+			Ar << Index << Name;
+
+			// The recorder hands out indices in order, so a valid name either redefines one or adds the next
+			if (Index < 0 || Index > AnchorNames.Num())
+			{
+				UE_LOG(LogTemp, Error, TEXT("%s defines anchor name %d out of order"), *Filename, Index);
+				return false;
+			}
+			if (Index == AnchorNames.Num())
+			{
+				AnchorNames.AddDefaulted();
+			}
+			AnchorNames[Index] = FName(*Name);
+			continue;
+		}
+
+		FTeleportTraceRecord& Record = OutRecords.AddDefaulted_GetRef();
+		Record.Type = Type;
+		Ar << Record.Time << Record.PlayerId << Record.Position;
+
+		if (Type == ETeleportTraceEvent::Teleport)
+		{
+			int32 SourceIndex = 0;
+			int32 TargetIndex = 0;
+			Ar << SourceIndex << TargetIndex;
+			Record.SourceAnchor = AnchorNames.IsValidIndex(SourceIndex) ? AnchorNames[SourceIndex] : NAME_None;
+			Record.TargetAnchor = AnchorNames.IsValidIndex(TargetIndex) ? AnchorNames[TargetIndex] : NAME_None;
+		}
+	}
+
+	return !Ar.IsError();
+}
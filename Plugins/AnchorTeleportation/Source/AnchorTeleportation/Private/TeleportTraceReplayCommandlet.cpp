@@ -0,0 +1,269 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportTraceReplayCommandlet.h"
+#include "Anchor.h"
+#include "TeleportTraceRecorder.h"
+#include "TeleportationWorldSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/PlatformTime.h"
+#include "Pieces/BigTeleportationPiece.h"
+#include "Pieces/SmallTeleportationPieces.h"
+#include "Pieces/TeleportationPieceManager.h"
+#include "UObject/Package.h"
+#if WITH_EDITOR
+#include "WorldPartition/WorldPartition.h"
+#include "WorldPartition/WorldPartitionActorDescInstance.h"
+#include "WorldPartition/WorldPartitionHandle.h"
+#include "WorldPartition/WorldPartitionHelpers.h"
+#endif
+
+namespace TeleportTraceReplay
+{
+	// Pieces land 150 to 300 units from the break, the replayed ones are not where the recorded ones were
+	constexpr float PickupSearchRadius = 400.f;
+
+	const TCHAR* GetEventName(ETeleportTraceEvent Type)
+	{
+		switch (Type)
+		{
+		case ETeleportTraceEvent::Teleport: return TEXT("Teleport");
+		case ETeleportTraceEvent::Break: return TEXT("Break");
+		case ETeleportTraceEvent::Pickup: return TEXT("Pickup");
+		default: return TEXT("Other");
+		}
+	}
+
+	bool ReplayTeleport(const FTeleportAnchorTable& Table, const FTeleportTraceRecord& Record)
+	{
+		float DistSquared = 0.f;
+		const int32 Nearest = Table.Locations.FindNearest(FVector(Record.Position), DistSquared);
+		if (Nearest == INDEX_NONE) return false;
+
+		// The map may have changed since the trace was recorded
+		const AAnchor* Source = Table.Locations.Anchors[Nearest];
+		return Source && Source->AnchorID == Record.SourceAnchor && (Source->IsRemote() || Table.FindPaired(Nearest));
+	}
+
+	bool ReplayBreak(UWorld* World, const FTeleportTraceRecord& Record)
+	{
+		ABigTeleportationPiece* Closest = nullptr;
+		double BestDistSquared = MAX_dbl;
+		for (ABigTeleportationPiece* Source : TActorRange<ABigTeleportationPiece>(World))
+		{
+			const double DistSquared = FVector::DistSquared(FVector(Record.Position), Source->GetActorLocation());
+			if (Source->bSourceActive && DistSquared < BestDistSquared)
+			{
+				BestDistSquared = DistSquared;
+				Closest = Source;
+			}
+		}
+		if (!Closest) return false;
+
+		Closest->StartBreak(nullptr, FVector(Record.Position));
+		return true;
+	}
+
+	// Does what the server does for a pickup to the closest live piece, actor or managed
+	bool ReplayPickup(UWorld* World, const FTeleportTraceRecord& Record)
+	{
+		const FVector Position(Record.Position);
+		double BestDistSquared = FMath::Square(PickupSearchRadius);
+
+		ASmallTeleportationPieces* ClosestPiece = nullptr;
+		for (ASmallTeleportationPieces* Piece : TActorRange<ASmallTeleportationPieces>(World))
+		{
+			const double DistSquared = FVector::DistSquared(Position, Piece->GetActorLocation());
+			if (!Piece->bIsCollected && DistSquared < BestDistSquared)
+			{
+				BestDistSquared = DistSquared;
+				ClosestPiece = Piece;
+			}
+		}
+
+		ATeleportationPieceManager* ClosestManager = nullptr;
+		int32 ClosestItem = INDEX_NONE;
+		for (ATeleportationPieceManager* Manager : TActorRange<ATeleportationPieceManager>(World))
+		{
+			for (int32 ItemIndex = 0; ItemIndex < Manager->Pieces.Items.Num(); ItemIndex++)
+			{
+				const double DistSquared = FVector::DistSquared(Position, Manager->Pieces.Items[ItemIndex].Location);
+				if (DistSquared < BestDistSquared)
+				{
+					BestDistSquared = DistSquared;
+					ClosestManager = Manager;
+					ClosestItem = ItemIndex;
+				}
+			}
+		}
+
+		if (ClosestManager)
+		{
+			ClosestManager->RemovePieceAt(ClosestItem);
+			return true;
+		}
+
+		if (ClosestPiece)
+		{
+			ClosestPiece->bIsCollected = true;
+			if (ClosestPiece->SourcePiece.IsValid())
+			{
+				ClosestPiece->SourcePiece->MarkPieceCollected(ClosestPiece->BreakId, ClosestPiece->PieceIndex);
+			}
+			ClosestPiece->Destroy();
+			return true;
+		}
+
+		return false;
+	}
+}
+
+UTeleportTraceReplayCommandlet::UTeleportTraceReplayCommandlet()
+{
+	IsClient = false;
+	IsServer = true;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UTeleportTraceReplayCommandlet::Main(const FString& Params)
+{
+	using namespace TeleportTraceReplay;
+
+	FString TraceFile;
+	FString MapName;
+	int32 Repeat = 1;
+	FParse::Value(*Params, TEXT("Trace="), TraceFile);
+	FParse::Value(*Params, TEXT("Map="), MapName);
+	FParse::Value(*Params, TEXT("Repeat="), Repeat);
+	Repeat = FMath::Max(1, Repeat);
+
+	TArray<FTeleportTraceRecord> Records;
+	if (TraceFile.IsEmpty() || !FTeleportTraceRecorder::ReadTrace(TraceFile, Records))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not read teleport trace '%s'"), *TraceFile);
+		return 1;
+	}
+
+	UPackage* MapPackage = MapName.IsEmpty() ? nullptr : LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not load map '%s'"), *MapName);
+		return 1;
+	}
+
+	// Bring the world up the way a server would, anchors register with the world subsystem in BeginPlay
+	World->WorldType = EWorldType::Game;
+	World->AddToRoot();
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitWorld(UWorld::InitializationValues()
+		.AllowAudioPlayback(false)
+		.RequiresHitProxies(false)
+		.CreateNavigation(false)
+		.CreateAISystem(false)
+		.ShouldSimulatePhysics(false)
+		.SetTransactional(false));
+
+#if WITH_EDITOR
+	// Nothing streams in a commandlet, load every anchor and piece source of a partitioned map up front
+	TArray<FWorldPartitionReference> ActorReferences;
+	if (UWorldPartition* WorldPartition = World->GetWorldPartition())
+	{
+		auto AddReference = [&ActorReferences, WorldPartition](const FWorldPartitionActorDescInstance* ActorDesc)
+		{
+			ActorReferences.Emplace(WorldPartition, ActorDesc->GetGuid());
+			return true;
+		};
+		FWorldPartitionHelpers::ForEachActorDescInstance<AAnchor>(WorldPartition, AddReference);
+		FWorldPartitionHelpers::ForEachActorDescInstance<ABigTeleportationPiece>(WorldPartition, AddReference);
+	}
+#endif
+
+	World->UpdateWorldComponents(true, false);
+	const FURL URL;
+	World->SetGameMode(URL);
+	World->InitializeActorsForPlay(URL);
+	World->BeginPlay();
+
+	UTeleportationWorldSubsystem* WorldSubsystem = World->GetSubsystem<UTeleportationWorldSubsystem>();
+	const TSharedRef<const FTeleportAnchorTable> Table = WorldSubsystem->GetAnchorTable();
+	if (Table->Locations.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Map '%s' has no anchors"), *MapName);
+		return 1;
+	}
+
+	// Each event is timed on its own with the cycle counter, so the percentiles show single slow events and not batch
+	// averages. Piece timers advance by the recorded gaps between events, outside the timed part
+	constexpr int32 NumEventTypes = static_cast<int32>(ETeleportTraceEvent::Pickup) + 1;
+	TArray<uint64> EventCycles[NumEventTypes];
+	int32 Counts[NumEventTypes] = {};
+	int32 Mismatches[NumEventTypes] = {};
+
+	const double ReplayStart = FPlatformTime::Seconds();
+	for (int32 Pass = 0; Pass < Repeat; ++Pass)
+	{
+		float LastTime = 0.f;
+		for (const FTeleportTraceRecord& Record : Records)
+		{
+			if (Record.Type == ETeleportTraceEvent::AnchorName) continue;
+
+			WorldSubsystem->TimerWheel.Advance(FMath::Max(Record.Time - LastTime, 0.f));
+			LastTime = Record.Time;
+
+			bool bMatched = false;
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			switch (Record.Type)
+			{
+			case ETeleportTraceEvent::Teleport: bMatched = ReplayTeleport(*Table, Record); break;
+			case ETeleportTraceEvent::Break: bMatched = ReplayBreak(World, Record); break;
+			case ETeleportTraceEvent::Pickup: bMatched = ReplayPickup(World, Record); break;
+			default: break;
+			}
+			const uint64 Cycles = FPlatformTime::Cycles64() - StartCycles;
+
+			const int32 TypeIndex = static_cast<int32>(Record.Type);
+			EventCycles[TypeIndex].Add(Cycles);
+			Counts[TypeIndex]++;
+			Mismatches[TypeIndex] += bMatched ? 0 : 1;
+		}
+	}
+	const double ReplaySeconds = FPlatformTime::Seconds() - ReplayStart;
+
+	const int32 NumEvents = Counts[1] + Counts[2] + Counts[3];
+	if (NumEvents == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Trace '%s' contains no teleports, breaks or pickups"), *TraceFile);
+		return 0;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Replayed %d events against %d anchors in %.3f s (%.0f/s)"),
+	       NumEvents, Table->Locations.Num(), ReplaySeconds, NumEvents / FMath::Max(ReplaySeconds, UE_DOUBLE_SMALL_NUMBER));
+
+	for (const ETeleportTraceEvent Type : { ETeleportTraceEvent::Teleport, ETeleportTraceEvent::Break, ETeleportTraceEvent::Pickup })
+	{
+		const int32 TypeIndex = static_cast<int32>(Type);
+		TArray<uint64>& Latencies = EventCycles[TypeIndex];
+		if (Latencies.Num() == 0) continue;
+
+		Latencies.Sort();
+		auto Percentile = [&Latencies](float P)
+		{
+			const int32 Index = FMath::Clamp(FMath::CeilToInt(P * Latencies.Num()) - 1, 0, Latencies.Num() - 1);
+			return FPlatformTime::ToMilliseconds64(Latencies[Index]) * 1000.0;
+		};
+
+		UE_LOG(LogTemp, Display, TEXT("%s: %d events, latency p50 %.2f us, p95 %.2f us, p99 %.2f us, max %.2f us"),
+		       GetEventName(Type), Counts[TypeIndex], Percentile(0.5f), Percentile(0.95f), Percentile(0.99f), Percentile(1.f));
+		if (Mismatches[TypeIndex] > 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s: %d events did not replay like they were recorded"), GetEventName(Type), Mismatches[TypeIndex]);
+		}
+	}
+
+	return 0;
+}
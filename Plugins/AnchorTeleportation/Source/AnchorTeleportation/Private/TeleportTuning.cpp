@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportTuning.h"
+#include "HAL/IConsoleManager.h"
+
+namespace TeleportTuning
+{
+	float Cooldown = -1.f;
+	float FadeDuration = -1.f;
+	int32 MaxPieces = -1;
+	float RespawnTime = -1.f;
+	float DespawnTime = -1.f;
+}
+
+static FAutoConsoleVariableRef GTeleportTuneCooldownCVar(
+	TEXT("teleport.tune.cooldown"),
+	TeleportTuning::Cooldown,
+	TEXT("Seconds between teleports for cooldown policies, negative uses TeleportCooldown of each component"));
+
+static FAutoConsoleVariableRef GTeleportTuneFadeDurationCVar(
+	TEXT("teleport.tune.fadeduration"),
+	TeleportTuning::FadeDuration,
+	TEXT("Seconds an after image takes to fade, negative uses FadeDuration of each component"));
+
+static FAutoConsoleVariableRef GTeleportTuneMaxPiecesCVar(
+	TEXT("teleport.tune.maxpieces"),
+	TeleportTuning::MaxPieces,
+	TEXT("Most pieces a broken source spawns, negative uses MaxPieces of each source"));
+
+static FAutoConsoleVariableRef GTeleportTuneRespawnTimeCVar(
+	TEXT("teleport.tune.respawntime"),
+	TeleportTuning::RespawnTime,
+	TEXT("Seconds before a broken source comes back, negative uses RespawnTime of each source"));
+
+static FAutoConsoleVariableRef GTeleportTuneDespawnTimeCVar(
+	TEXT("teleport.tune.despawntime"),
+	TeleportTuning::DespawnTime,
+	TEXT("Seconds an uncollected piece stays around, negative uses DespawnTime of the piece class or manager"));
+
+static FAutoConsoleCommand GTeleportTuneResetCommand(
+	TEXT("teleport.tune.reset"),
+	TEXT("Drops every teleport.tune override and goes back to the values from the assets"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (const TCHAR* Name : { TEXT("teleport.tune.cooldown"), TEXT("teleport.tune.fadeduration"), TEXT("teleport.tune.maxpieces"),
+			TEXT("teleport.tune.respawntime"), TEXT("teleport.tune.despawntime") })
+		{
+			IConsoleManager::Get().FindConsoleVariable(Name)->Set(-1, ECVF_SetByConsole);
+		}
+	}));
+
+float FTeleportTuning::GetCooldown(float AssetValue)
+{
+	return TeleportTuning::Cooldown >= 0.f ? TeleportTuning::Cooldown : AssetValue;
+}
+
+float FTeleportTuning::GetFadeDuration(float AssetValue)
+{
+	return TeleportTuning::FadeDuration >= 0.f ? TeleportTuning::FadeDuration : AssetValue;
+}
+
+int32 FTeleportTuning::GetMaxPieces(int32 AssetValue)
+{
+	return TeleportTuning::MaxPieces >= 0 ? TeleportTuning::MaxPieces : AssetValue;
+}
+
+float FTeleportTuning::GetRespawnTime(float AssetValue)
+{
+	return TeleportTuning::RespawnTime >= 0.f ? TeleportTuning::RespawnTime : AssetValue;
+}
+
+float FTeleportTuning::GetDespawnTime(float AssetValue)
+{
+	return TeleportTuning::DespawnTime >= 0.f ? TeleportTuning::DespawnTime : AssetValue;
+}
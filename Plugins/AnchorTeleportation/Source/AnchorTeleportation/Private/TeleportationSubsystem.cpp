@@ -1,13 +1,52 @@
 #include "TeleportationSubsystem.h"
 #include "Anchor.h"
+#include "AnchorTeleportationReplicationGraph.h"
 #include "EngineUtils.h"
+#include "Engine/AssetManager.h"
+#include "Engine/GameInstance.h"
+#include "Engine/NetConnection.h"
+#include "Engine/StreamableManager.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/CapsuleComponent.h"
 #include "Components/SphereComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
 #include "GameFramework/PlayerController.h"
 #include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
 #include "Kismet/GameplayStatics.h"
+#include "Materials/MaterialInstanceDynamic.h"
 #include "Net/UnrealNetwork.h"
+#include "Pieces/BigTeleportationPiece.h"
 #include "Pieces/SmallTeleportationPieces.h"
 #include "Sound/SoundCue.h"
+#include "TeleportHandoff.h"
+#include "TeleportHitchDetector.h"
+#include "TeleportMetrics.h"
+#include "TeleportPersistenceSubsystem.h"
+#include "TeleportationStats.h"
+#include "TeleportTraceRecorder.h"
+#include "TeleportTuning.h"
+#include "WorldPartition/WorldPartitionStreamingSource.h"
+#include "WorldPartition/WorldPartitionSubsystem.h"
+
+namespace TeleportationSubsystem
+{
+	ETeleportRejectReason GetRejectReason(ETeleportStage FailedStage)
+	{
+		switch (FailedStage)
+		{
+		case ETeleportStage::Validate:
+		case ETeleportStage::Move: return ETeleportRejectReason::Gated;
+		case ETeleportStage::Resolve: return ETeleportRejectReason::NoAnchor;
+		case ETeleportStage::Admit: return ETeleportRejectReason::QueueTimeout;
+		default: return ETeleportRejectReason::Other;
+		}
+	}
+}
+
+const FName UTeleportationSubsystem::AfterImageTag(TEXT("TeleportAfterImage"));
 
 UTeleportationSubsystem::UTeleportationSubsystem()
 {
@@ -18,39 +57,416 @@ UTeleportationSubsystem::UTeleportationSubsystem()
 void UTeleportationSubsystem::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	DOREPLIFETIME(UTeleportationSubsystem, AnchorPairs);
+	DOREPLIFETIME_CONDITION(UTeleportationSubsystem, AnchorPairs, COND_OwnerOnly);
 	DOREPLIFETIME(UTeleportationSubsystem, PickedUpPieces);
+	DOREPLIFETIME_CONDITION(UTeleportationSubsystem, ArrivalQueueStatus, COND_OwnerOnly);
 }
 
 void UTeleportationSubsystem::BeginPlay()
 {
 	Super::BeginPlay();
+
+	// Ghosts are copies of the character class, they only need to look like it
+	bIsAfterImage = GetOwner()->ActorHasTag(AfterImageTag);
+	if (bIsAfterImage) return;
+
+	GatingPolicy = FTeleportGatingPolicyRegistry::Create(GetGatingPolicyName());
+	if (!GatingPolicy)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Unknown teleport policy %s, falling back to Cooldown"), *GetGatingPolicyName().ToString());
+		GatingPolicy = MakeUnique<FTeleportCooldownPolicy>();
+	}
 	if (GetOwner()->HasAuthority())
 	{
-		for (TActorIterator<AAnchor> It(GetWorld()); It; ++It)
+		if (UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>())
+		{
+			AnchorTableChangedHandle = WorldSubsystem->OnAnchorTableChanged.AddUObject(this, &UTeleportationSubsystem::OnAnchorTableChanged);
+			RefreshReplicatedAnchors(true);
+			GetWorld()->GetTimerManager().SetTimer(AnchorInterestTimer, FTimerDelegate::CreateUObject(this, &UTeleportationSubsystem::RefreshReplicatedAnchors, false),
+				AnchorInterestRefreshInterval, true);
+		}
+
+		if (ACharacter* Character = Cast<ACharacter>(GetOwner()))
+		{
+			Character->OnCharacterMovementUpdated.AddDynamic(this, &UTeleportationSubsystem::OnOwnerMovementUpdated);
+			Character->ReceiveControllerChangedDelegate.AddDynamic(this, &UTeleportationSubsystem::OnOwnerControllerChanged);
+			RestorePersistentState();
+		}
+	}
+
+	if (GetWorld()->GetNetMode() != NM_DedicatedServer)
+	{
+		LoadEffectAssets();
+		GetWorld()->GetTimerManager().SetTimer(RemoteAnchorPreloadTimer, this, &UTeleportationSubsystem::UpdateRemoteAnchorPreloads, 0.5f, true);
+	}
+}
+
+void UTeleportationSubsystem::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (bIsAfterImage)
+	{
+		Super::EndPlay(EndPlayReason);
+		return;
+	}
+
+	CancelTeleport(TEXT("the component was removed"));
+
+	// The player may be on the way to another server, hand the state over without waiting
+	SavePersistentState();
+	UGameInstance* GameInstance = GetWorld()->GetGameInstance();
+	if (UTeleportPersistenceSubsystem* Persistence = GameInstance ? GameInstance->GetSubsystem<UTeleportPersistenceSubsystem>() : nullptr)
+	{
+		Persistence->FlushPendingWrites();
+
+		// If the player comes back here later, another server may have changed their charges in between
+		Persistence->Evict(PersistentPlayerKey);
+	}
+
+	if (UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>())
+	{
+		WorldSubsystem->OnAnchorTableChanged.Remove(AnchorTableChangedHandle);
+	}
+	GetWorld()->GetTimerManager().ClearTimer(AnchorInterestTimer);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UTeleportationSubsystem::OnOwnerControllerChanged(APawn* Pawn, AController* OldController, AController* NewController)
+{
+	RestorePersistentState();
+}
+
+void UTeleportationSubsystem::PlaceAtArrivalAnchor(const FTeleportPlayerState& State)
+{
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	const APlayerController* PlayerController = Pawn ? Cast<APlayerController>(Pawn->GetController()) : nullptr;
+	const UNetConnection* Connection = PlayerController ? PlayerController->GetNetConnection() : nullptr;
+	const TCHAR* AnchorOption = Connection ? Connection->URL.GetOption(*FString::Printf(TEXT("%s="), FTeleportHandoff::AnchorOption), nullptr) : nullptr;
+
+	const bool bPending = !State.PendingArrivalAnchor.IsNone()
+		&& FDateTime::UtcNow().ToUnixTimestampDecimal() - State.PendingArrivalUtc <= FTeleportHandoff::ArrivalTimeout;
+	if (!bPending)
+	{
+		if (AnchorOption)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s asked to arrive at %s but no server sent them there"), *GetOwner()->GetName(), AnchorOption);
+		}
+		return;
+	}
+
+	const FName ArrivalAnchorID = State.PendingArrivalAnchor;
+	if (AnchorOption && ArrivalAnchorID != FName(AnchorOption))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s asked to arrive at %s, placing them at %s where the source server sent them"),
+			*GetOwner()->GetName(), AnchorOption, *ArrivalAnchorID.ToString());
+	}
+
+	const TSharedRef<const FTeleportAnchorTable> Table = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>()->GetAnchorTable();
+	for (AAnchor* Anchor : Table->Locations.Anchors)
+	{
+		if (IsValid(Anchor) && Anchor->AnchorID == ArrivalAnchorID && !Anchor->IsRemote())
+		{
+			FVector ArrivalLocation = Anchor->GetActorLocation();
+			GetWorld()->FindTeleportSpot(GetOwner(), ArrivalLocation, GetOwner()->GetActorRotation());
+			TeleportMove(GetOwner(), ArrivalLocation);
+			UE_LOG(LogTemp, Log, TEXT("%s arrived at anchor %s"), *GetOwner()->GetName(), *ArrivalAnchorID.ToString());
+			return;
+		}
+	}
+
+	UE_LOG(LogTemp, Warning, TEXT("Arrival anchor %s does not exist on this map"), *ArrivalAnchorID.ToString());
+}
+
+void UTeleportationSubsystem::UpdateRemoteAnchorPreloads()
+{
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	if (!Pawn || !Pawn->IsLocallyControlled()) return;
+
+	if (!bArrivalNotified)
+	{
+		bArrivalNotified = true;
+		FTeleportHandoff::NotifyArrived(GetWorld());
+	}
+
+	// Anchors stream in with the level, so the list is refreshed every few seconds instead of once
+	if (RemoteAnchorRefreshCountdown-- <= 0)
+	{
+		RemoteAnchorRefreshCountdown = 20;
+		RemoteAnchors.Reset();
+		for (AAnchor* Anchor : TActorRange<AAnchor>(GetWorld()))
 		{
-			AAnchor* Anchor = *It;
-			if (Anchor)
+			if (Anchor->IsRemote() && !Anchor->DestinationMap.IsNull())
 			{
-				FReplicatedAnchorList* ExistingPair = AnchorPairs.FindByPredicate(
-					[Anchor](const FReplicatedAnchorList& Pair) { return Pair.AnchorID == Anchor->AnchorID; });
+				RemoteAnchors.Add(Anchor);
+			}
+		}
+	}
 
-				if (!ExistingPair)
-				{
-					FReplicatedAnchorList NewPair;
-					NewPair.AnchorID = Anchor->AnchorID;
-					NewPair.Anchors.Add(Anchor);
-					AnchorPairs.Add(NewPair);
-				}
-				else
-				{
-					ExistingPair->Anchors.Add(Anchor);
-				}
+	// Maps are only held while the pawn is within PreloadRadius of one of their anchors
+	const FVector Location = Pawn->GetActorLocation();
+	TSet<FString> MapsInRange;
+	for (const TWeakObjectPtr<AAnchor>& WeakAnchor : RemoteAnchors)
+	{
+		const AAnchor* Anchor = WeakAnchor.Get();
+		if (Anchor && FVector::DistSquared(Location, Anchor->GetActorLocation()) <= FMath::Square(Anchor->PreloadRadius))
+		{
+			MapsInRange.Add(Anchor->DestinationMap.GetLongPackageName());
+		}
+	}
+	FTeleportHandoff::UpdatePreloads(MapsInRange);
+}
+
+void UTeleportationSubsystem::ClientTravelToAnchor_Implementation(const FString& URL)
+{
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	if (APlayerController* PlayerController = Pawn ? Cast<APlayerController>(Pawn->GetController()) : nullptr)
+	{
+		FTeleportHandoff::BeginTravel(URL);
+		PlayerController->ClientTravel(URL, TRAVEL_Absolute);
+	}
+}
+
+void UTeleportationSubsystem::RestorePersistentState()
+{
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	const FString PlayerKey = UTeleportPersistenceSubsystem::GetPlayerKey(Pawn ? Pawn->GetController() : nullptr);
+	UGameInstance* GameInstance = GetWorld()->GetGameInstance();
+	UTeleportPersistenceSubsystem* Persistence = GameInstance ? GameInstance->GetSubsystem<UTeleportPersistenceSubsystem>() : nullptr;
+	if (PlayerKey.IsEmpty() || PlayerKey == PersistentPlayerKey || !Persistence) return;
+
+	Persistence->Get(PlayerKey, [WeakThis = TWeakObjectPtr<UTeleportationSubsystem>(this), PlayerKey](TOptional<FTeleportPlayerState> State)
+	{
+		UTeleportationSubsystem* This = WeakThis.Get();
+		if (!This || This->PersistentPlayerKey == PlayerKey) return;
+
+		This->PersistentPlayerKey = PlayerKey;
+		if (State.IsSet())
+		{
+			// Pieces picked up while the load was in flight are kept on top
+			This->PickedUpPieces += State->Charges;
+			This->GatingPolicy->RestoreState(State.GetValue(), This->GetWorld()->GetTimeSeconds());
+		}
+		This->PlaceAtArrivalAnchor(State.Get(FTeleportPlayerState()));
+
+		// Also clears the pending arrival, it is good for one placement only
+		This->SavePersistentState();
+	});
+}
+
+void UTeleportationSubsystem::SavePersistentState()
+{
+	UGameInstance* GameInstance = GetWorld()->GetGameInstance();
+	UTeleportPersistenceSubsystem* Persistence = GameInstance ? GameInstance->GetSubsystem<UTeleportPersistenceSubsystem>() : nullptr;
+	if (PersistentPlayerKey.IsEmpty() || !Persistence) return;
+
+	FTeleportPlayerState State;
+	State.Charges = PickedUpPieces;
+	State.PendingArrivalAnchor = DepartureAnchorID;
+	State.PendingArrivalUtc = DepartureUtc;
+	GatingPolicy->SaveState(State, GetWorld()->GetTimeSeconds());
+	Persistence->Put(PersistentPlayerKey, State);
+}
+
+void UTeleportationSubsystem::OnOwnerMovementUpdated(float DeltaSeconds, FVector OldLocation, FVector OldVelocity)
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (Now - MovementHistory.LatestTime() >= MovementSampleInterval)
+	{
+		MovementHistory.Add(GetOwner()->GetActorLocation(), Now);
+	}
+}
+
+bool UTeleportationSubsystem::WasRecentlyNear(const AAnchor* SourceAnchor) const
+{
+	if (MaxTeleportSourceDistance <= 0.f) return true;
+
+	const FVector AnchorLocation = SourceAnchor->GetActorLocation();
+	if (FVector::DistSquared(GetOwner()->GetActorLocation(), AnchorLocation) <= FMath::Square(MaxTeleportSourceDistance))
+	{
+		return true;
+	}
+
+	return MovementHistory.WasNear(AnchorLocation, MaxTeleportSourceDistance,
+		GetWorld()->GetTimeSeconds(), TeleportSourceWindow);
+}
+
+void UTeleportationSubsystem::LoadEffectAssets()
+{
+	TArray<FSoftObjectPath> AssetsToLoad;
+	for (const FSoftObjectPath& Path : { TeleportSoundCue.ToSoftObjectPath(), GhostMaterial.ToSoftObjectPath(), GhostImpostorMesh.ToSoftObjectPath() })
+	{
+		if (!Path.IsNull())
+		{
+			AssetsToLoad.Add(Path);
+		}
+	}
+
+	if (AssetsToLoad.Num() == 0) return;
+
+	EffectAssetsHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(AssetsToLoad,
+		FStreamableDelegate::CreateWeakLambda(this, [this]() { PrewarmEffects(); }));
+}
+
+void UTeleportationSubsystem::PrewarmEffects()
+{
+	UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>();
+	if (!WorldSubsystem) return;
+
+	const ACharacter* Character = Cast<ACharacter>(GetOwner());
+	USkeletalMesh* SkeletalMesh = Character && Character->GetMesh() ? Character->GetMesh()->GetSkeletalMeshAsset() : nullptr;
+	WorldSubsystem->PrewarmEffects(TeleportSoundCue.Get(), GhostMaterial.Get(), GhostMaterialPoolSize, SkeletalMesh, GhostImpostorMesh.Get());
+}
+
+void UTeleportationSubsystem::OnAnchorTableChanged()
+{
+	RefreshReplicatedAnchors(true);
+}
+
+bool FReplicatedAnchorList::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	UPackageMap::StaticSerializeName(Ar, AnchorID);
+
+	const TConstArrayView<AAnchor*> GroupAnchors = Ar.IsSaving() ? GetAnchors() : TConstArrayView<AAnchor*>();
+	uint32 NumAnchors = GroupAnchors.Num();
+	Ar.SerializeIntPacked(NumAnchors);
+
+	if (Ar.IsLoading())
+	{
+		// A group is never larger than this, anything else is a corrupt or hostile packet
+		if (NumAnchors > 1024)
+		{
+			Ar.SetError();
+			bOutSuccess = false;
+			return false;
+		}
+
+		Anchors.SetNum(NumAnchors);
+		for (AAnchor*& Anchor : Anchors)
+		{
+			UObject* Object = nullptr;
+			Map->SerializeObject(Ar, AAnchor::StaticClass(), Object);
+			Anchor = Cast<AAnchor>(Object);
+		}
+	}
+	else
+	{
+		for (AAnchor* Anchor : GroupAnchors)
+		{
+			UObject* Object = Anchor;
+			Map->SerializeObject(Ar, AAnchor::StaticClass(), Object);
+		}
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+void UTeleportationSubsystem::RefreshReplicatedAnchors(bool bAnchorTableChanged)
+{
+	const TSharedRef<const FTeleportAnchorTable> Table = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>()->GetAnchorTable();
+
+	// Items point into the table, so a new one has to reach every item before the old one is released
+	const TSharedPtr<const FTeleportAnchorTable> PreviousTable = AnchorPairs.Table;
+	bAnchorTableChanged |= PreviousTable.Get() != &Table.Get();
+	AnchorPairs.Table = Table;
+
+	// Groups with at least one anchor inside the interest radius, keyed by their ID
+	TMap<FName, int32> InterestGroups;
+	if (AnchorInterestRadius > 0.f)
+	{
+		TArray<int32> NearbyAnchors;
+		Table->Locations.FindWithinRadius(GetOwner()->GetActorLocation(), AnchorInterestRadius, NearbyAnchors);
+		for (int32 AnchorIndex : NearbyAnchors)
+		{
+			const int32 Group = Table->Locations.GroupIndex[AnchorIndex];
+			InterestGroups.Add(Table->GetGroup(Group)[0]->AnchorID, Group);
+		}
+	}
+
+	// Only a changed table can alter groups that are already replicated but out of range
+	TMap<FName, int32> AllGroups;
+	if (bAnchorTableChanged || AnchorInterestRadius <= 0.f)
+	{
+		AllGroups.Reserve(Table->NumGroups());
+		for (int32 Group = 0; Group < Table->NumGroups(); Group++)
+		{
+			AllGroups.Add(Table->GetGroup(Group)[0]->AnchorID, Group);
+		}
+		if (AnchorInterestRadius <= 0.f)
+		{
+			InterestGroups = AllGroups;
+		}
+	}
+
+	bool bRemovedAny = false;
+	for (int32 Index = AnchorPairs.Items.Num() - 1; Index >= 0; Index--)
+	{
+		FReplicatedAnchorList& Item = AnchorPairs.Items[Index];
+
+		int32 Group = INDEX_NONE;
+		const bool bInRange = InterestGroups.RemoveAndCopyValue(Item.AnchorID, Group);
+		if (!bInRange)
+		{
+			if (!bRememberDiscoveredAnchors || (bAnchorTableChanged && !AllGroups.Contains(Item.AnchorID)))
+			{
+				AnchorPairs.Items.RemoveAtSwap(Index);
+				bRemovedAny = true;
+				continue;
+			}
+			if (bAnchorTableChanged)
+			{
+				Group = AllGroups[Item.AnchorID];
 			}
 		}
+
+		if (Group == INDEX_NONE) continue;
+
+		const TConstArrayView<AAnchor*> Anchors = Table->GetGroup(Group);
+		const TConstArrayView<AAnchor*> Current = Item.GetAnchors();
+		const bool bChanged = Current.Num() != Anchors.Num() || FMemory::Memcmp(Current.GetData(), Anchors.GetData(), Anchors.Num() * sizeof(AAnchor*)) != 0;
+		Item.Table = &Table.Get();
+		Item.Group = Group;
+		if (bChanged)
+		{
+			AnchorPairs.MarkItemDirty(Item);
+		}
+	}
+
+	if (bRemovedAny)
+	{
+		AnchorPairs.MarkArrayDirty();
+	}
+
+	for (const TPair<FName, int32>& NewGroup : InterestGroups)
+	{
+		FReplicatedAnchorList& Item = AnchorPairs.Items.AddDefaulted_GetRef();
+		Item.AnchorID = NewGroup.Key;
+		Item.Table = &Table.Get();
+		Item.Group = NewGroup.Value;
+		AnchorPairs.MarkItemDirty(Item);
 	}
 }
 
+SIZE_T UTeleportationSubsystem::GetAnchorListAllocatedSize() const
+{
+	SIZE_T Size = AnchorPairs.Items.GetAllocatedSize();
+	for (const FReplicatedAnchorList& Entry : AnchorPairs.Items)
+	{
+		Size += Entry.Anchors.GetAllocatedSize();
+	}
+	return Size;
+}
+
+SIZE_T UTeleportationSubsystem::GetAllocatedSize() const
+{
+	SIZE_T Size = GetAnchorListAllocatedSize();
+	if (GatingPolicy)
+	{
+		Size += GatingPolicy->GetInstanceSize();
+	}
+	return Size;
+}
+
 void UTeleportationSubsystem::ClientRequestTeleport(APlayerController* PlayerController)
 {
 	if (!PlayerController)
@@ -72,9 +488,9 @@ void UTeleportationSubsystem::ClientRequestTeleport(APlayerController* PlayerCon
 		return;
 	}
 	
-	if (AnchorPairs.Num() == 0)
+	if (AnchorPairs.Items.Num() == 0)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("No anchor pairs available"));
+		UE_LOG(LogTemp, Warning, TEXT("No anchors in range"));
 		return;
 	}
 	
@@ -100,51 +516,50 @@ AAnchor* UTeleportationSubsystem::FindPairedAnchor(AAnchor* CurrentAnchor) const
 		return nullptr;
 	}
 
-	const FReplicatedAnchorList* AnchorEntry = AnchorPairs.FindByPredicate(
-		[CurrentAnchor](const FReplicatedAnchorList& Entry)
-		{
-			return Entry.AnchorID == CurrentAnchor->AnchorID;
-		});
-
-	if (!AnchorEntry || AnchorEntry->Anchors.Num() < 2)
+	const TSharedRef<const FTeleportAnchorTable> Table = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>()->GetAnchorTable();
+	const int32 AnchorIndex = Table->IndexOf(CurrentAnchor);
+	AAnchor* PairedAnchor = Table->FindPaired(AnchorIndex);
+	if (!PairedAnchor)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("No valid anchor pair found for %s"),
+		// Orphans are reported once when the table is built
+		UE_LOG(LogTemp, Verbose, TEXT("No valid anchor pair found for %s"),
 		       *CurrentAnchor->AnchorID.ToString());
 		return nullptr;
 	}
 
-	for (AAnchor* Anchor : AnchorEntry->Anchors)
+	UE_LOG(LogTemp, Log, TEXT("Found Paired Anchor: %s -> %s"),
+	       *CurrentAnchor->AnchorID.ToString(), *PairedAnchor->AnchorID.ToString());
+	return PairedAnchor;
+}
+
+TArray<AAnchor*> UTeleportationSubsystem::GetAnchorGroup(FName AnchorID) const
+{
+	for (const FReplicatedAnchorList& Entry : AnchorPairs.Items)
 	{
-		if (Anchor && Anchor != CurrentAnchor)
+		if (Entry.AnchorID == AnchorID)
 		{
-			UE_LOG(LogTemp, Log, TEXT("Found Paired Anchor: %s -> %s"),
-			       *CurrentAnchor->AnchorID.ToString(), *Anchor->AnchorID.ToString());
-			return Anchor;
+			return TArray<AAnchor*>(Entry.GetAnchors());
 		}
 	}
-
-	return nullptr;
+	return TArray<AAnchor*>();
 }
 
 bool UTeleportationSubsystem::CanTeleport(APlayerController* PlayerController) const
 {
-	if (!PlayerController) return false;
-	
-	if (bPickUpTeleportation)
-	{
-		if (PickedUpPieces > 0)
-		{
-			return true;
-		}
-		return false;
-	}
-	
-	const float* LastTeleportTime = LastTeleportTimes.Find(PlayerController);
-	if (LastTeleportTime)
-	{
-		return (GetWorld()->GetTimeSeconds() - *LastTeleportTime) >= TeleportCooldown;
-	}
-	return true;
+	if (!PlayerController || !GatingPolicy) return false;
+
+	SCOPE_CYCLE_COUNTER(STAT_TeleportGating);
+
+	uint32 Charges = PickedUpPieces;
+	const FTeleportGateContext Context{GetWorld()->GetTimeSeconds(), FTeleportTuning::GetCooldown(TeleportCooldown), Charges};
+	return GatingPolicy->CanTeleport(Context);
+}
+
+FName UTeleportationSubsystem::GetGatingPolicyName() const
+{
+	if (!TeleportPolicy.IsNone()) return TeleportPolicy;
+
+	return bPickUpTeleportation ? FTeleportGatingPolicyRegistry::Charges : FTeleportGatingPolicyRegistry::Cooldown;
 }
 
 void UTeleportationSubsystem::CollectTeleportationPiece(APlayerController* PlayerController)
@@ -192,6 +607,13 @@ void UTeleportationSubsystem::CollectTeleportationPiece(APlayerController* Playe
 		
 		Pieces->bIsCollected = true;
 		PickedUpPieces++;
+		FTeleportTraceRecorder::Get().RecordPickup(FTeleportTraceRecorder::GetPlayerId(PlayerController), Pieces->GetActorLocation());
+		SavePersistentState();
+
+		if (Pieces->SourcePiece.IsValid())
+		{
+			Pieces->SourcePiece->MarkPieceCollected(Pieces->BreakId, Pieces->PieceIndex);
+		}
 
 		UE_LOG(LogTemp, Log, TEXT("✅ Picked Up Pieces: %d"), PickedUpPieces);
 		
@@ -205,8 +627,36 @@ void UTeleportationSubsystem::CollectTeleportationPiece(APlayerController* Playe
 	}
 }
 
+bool UTeleportationSubsystem::IsRpcFromOwningConnection(APlayerController* PlayerController) const
+{
+	// A null controller is dropped by the implementation, a controller from another connection is a spoof
+	return !PlayerController || PlayerController->GetNetConnection() == GetOwner()->GetNetConnection();
+}
+
+bool UTeleportationSubsystem::ConsumeServerRpcBudget()
+{
+	if (ServerRpcBudget.TryConsume(FPlatformTime::Seconds(), ServerRpcRate, ServerRpcBurst))
+	{
+		return true;
+	}
+
+	RejectedRpcCount++;
+	INC_DWORD_STAT(STAT_TeleportRejectedRpcs);
+	FTeleportMetrics::Get().CountReject(ETeleportRejectReason::RateLimited);
+	return false;
+}
+
+bool UTeleportationSubsystem::ServerCollectTeleportationPiece_Validate(APlayerController* PlayerController)
+{
+	return IsRpcFromOwningConnection(PlayerController);
+}
+
 void UTeleportationSubsystem::ServerCollectTeleportationPiece_Implementation(APlayerController* PlayerController)
 {
+	GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>()->CountServerRpc(ETeleportServerRpc::CollectPiece);
+
+	if (!ConsumeServerRpcBudget()) return;
+
 	UE_LOG(LogTemp, Log, TEXT("CollectTeleportationPiece called"));
 
 	if (!PlayerController)
@@ -247,6 +697,13 @@ void UTeleportationSubsystem::ServerCollectTeleportationPiece_Implementation(APl
 	
 	Pieces->bIsCollected = true;
 	PickedUpPieces++;
+	FTeleportTraceRecorder::Get().RecordPickup(FTeleportTraceRecorder::GetPlayerId(PlayerController), Pieces->GetActorLocation());
+	SavePersistentState();
+
+	if (Pieces->SourcePiece.IsValid())
+	{
+		Pieces->SourcePiece->MarkPieceCollected(Pieces->BreakId, Pieces->PieceIndex);
+	}
 
 	UE_LOG(LogTemp, Log, TEXT("Picked Up Pieces: %d"), PickedUpPieces);
 	
@@ -255,8 +712,17 @@ void UTeleportationSubsystem::ServerCollectTeleportationPiece_Implementation(APl
 	Pieces = nullptr;
 }
 
+bool UTeleportationSubsystem::ServerTeleportPlayer_Validate(APlayerController* PlayerController)
+{
+	return IsRpcFromOwningConnection(PlayerController);
+}
+
 void UTeleportationSubsystem::ServerTeleportPlayer_Implementation(APlayerController* PlayerController)
 {
+	GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>()->CountServerRpc(ETeleportServerRpc::Teleport);
+
+	if (!ConsumeServerRpcBudget()) return;
+
 	if (!PlayerController)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("PlayerController is NULL"));
@@ -267,135 +733,623 @@ void UTeleportationSubsystem::ServerTeleportPlayer_Implementation(APlayerControl
 	if (!Character)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("Character is NULL"));
+		FTeleportMetrics::Get().CountReject(ETeleportRejectReason::NoPawn);
 		return;
 	}
-	
-	if (bPickUpTeleportation)
+
+	if (ActiveTeleport)
 	{
-		if (PickedUpPieces > 0)
+		UE_LOG(LogTemp, Warning, TEXT("%s already has a teleport in progress"), *Character->GetName());
+		FTeleportMetrics::Get().CountReject(ETeleportRejectReason::AlreadyTeleporting);
+		return;
+	}
+
+	ActiveTeleport = MakeUnique<FTeleportPipeline>();
+	ActiveTeleport->StartTime = FPlatformTime::Seconds();
+	ActiveTeleport->PlayerController = PlayerController;
+	ActiveTeleport->Character = Character;
+
+	GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>()->StartTeleport(this);
+}
+
+bool UTeleportationSubsystem::TickTeleport()
+{
+	if (!ActiveTeleport) return false;
+
+	FTeleportPipeline& Pipeline = *ActiveTeleport;
+	APlayerController* PlayerController = Pipeline.PlayerController.Get();
+	ACharacter* Character = Pipeline.Character.Get();
+	if (!PlayerController || !Character || PlayerController->GetPawn() != Character)
+	{
+		CancelTeleport(TEXT("the player died or disconnected"));
+		return false;
+	}
+
+	UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>();
+
+	// Stages that finish right away fall through to the next one in the same frame
+	while (Pipeline.Stage != ETeleportStage::Num)
+	{
+		const bool bEntering = !Pipeline.bStageEntered;
+		if (bEntering)
+		{
+			Pipeline.bStageEntered = true;
+			Pipeline.StageStartTime = FPlatformTime::Seconds();
+			Pipeline.StageStartWorldTime = GetWorld()->GetTimeSeconds();
+		}
+
+		const ETeleportStageResult Result = RunTeleportStage(Pipeline, bEntering, PlayerController, Character);
+		if (Result == ETeleportStageResult::Pending) return true;
+
+		WorldSubsystem->RecordStageLatency(Pipeline.Stage, FPlatformTime::Seconds() - Pipeline.StageStartTime);
+		if (Result == ETeleportStageResult::Failed)
 		{
-			PickedUpPieces--;
-			UE_LOG(LogTemp, Log, TEXT("Used a teleportation charge. Remaining: %d"),
-			       PickedUpPieces);
+			FTeleportMetrics::Get().CountReject(TeleportationSubsystem::GetRejectReason(Pipeline.Stage));
+			break;
+		}
+
+		Pipeline.Stage = static_cast<ETeleportStage>(static_cast<uint8>(Pipeline.Stage) + 1);
+		Pipeline.bStageEntered = false;
+	}
+
+	if (Pipeline.Stage == ETeleportStage::Num)
+	{
+		WorldSubsystem->RecordTeleportLatency(FPlatformTime::Seconds() - Pipeline.StartTime);
+		FTeleportMetrics::Get().Teleports.Add();
+	}
+
+	FinishTeleport();
+	return false;
+}
+
+void UTeleportationSubsystem::CancelTeleport(const TCHAR* Reason)
+{
+	if (!ActiveTeleport) return;
+
+	UE_LOG(LogTemp, Log, TEXT("Teleport cancelled during %s: %s"), LexToString(ActiveTeleport->Stage), Reason);
+
+	// Undo a fade the client may already be in
+	if (ActiveTeleport->Stage >= ETeleportStage::FadeOut && ActiveTeleport->PlayerController.IsValid())
+	{
+		ClientTeleportFade(1.f, 0.f, 0.f);
+	}
+
+	FinishTeleport();
+}
+
+void UTeleportationSubsystem::FinishTeleport()
+{
+	if (!ActiveTeleport) return;
+
+	if (UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>())
+	{
+		WorldSubsystem->ReleaseLandingSlot(ActiveTeleport->LandingSlot);
+		if (AAnchor* QueuedAnchor = ActiveTeleport->QueuedAnchor.Get())
+		{
+			WorldSubsystem->LeaveArrivalQueue(QueuedAnchor, this);
+		}
+	}
+	ArrivalQueueStatus = FTeleportQueueStatus();
+	ActiveTeleport.Reset();
+}
+
+void UTeleportationSubsystem::OnArrivalAdmitted()
+{
+	if (!ActiveTeleport) return;
+
+	ActiveTeleport->QueuedAnchor.Reset();
+	ActiveTeleport->bArrivalAdmitted = true;
+	ArrivalQueueStatus = FTeleportQueueStatus();
+}
+
+void UTeleportationSubsystem::UpdateArrivalQueueStatus(int32 Position, float EtaSeconds)
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	const float ClientEta = ArrivalQueueStatus.EtaSeconds - static_cast<float>(Now - ArrivalQueueStatusTime);
+	if (ArrivalQueueStatus.Position != 0 && FMath::Abs(ClientEta - EtaSeconds) <= 1.f) return;
+
+	ArrivalQueueStatus.Position = Position;
+	ArrivalQueueStatus.EtaSeconds = FMath::Max(EtaSeconds, 0.f);
+	ArrivalQueueStatusTime = Now;
+}
+
+float UTeleportationSubsystem::GetArrivalQueueEta() const
+{
+	if (ArrivalQueueStatus.Position == 0) return 0.f;
+
+	return FMath::Max(ArrivalQueueStatus.EtaSeconds - static_cast<float>(GetWorld()->GetTimeSeconds() - ArrivalQueueStatusTime), 0.f);
+}
+
+void UTeleportationSubsystem::OnRep_ArrivalQueueStatus()
+{
+	ArrivalQueueStatusTime = GetWorld()->GetTimeSeconds();
+}
+
+ETeleportStageResult UTeleportationSubsystem::RunTeleportStage(FTeleportPipeline& Pipeline, bool bEntering, APlayerController* PlayerController, ACharacter* Character)
+{
+	UWorld* World = GetWorld();
+	UTeleportationWorldSubsystem* WorldSubsystem = World->GetSubsystem<UTeleportationWorldSubsystem>();
+	const double StageElapsed = World->GetTimeSeconds() - Pipeline.StageStartWorldTime;
+
+	switch (Pipeline.Stage)
+	{
+	case ETeleportStage::Validate:
+	{
+		if (!CanTeleport(PlayerController))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Teleport refused by the %s policy"), *GetGatingPolicyName().ToString());
+			return ETeleportStageResult::Failed;
+		}
+
+		Pipeline.SourceLocation = Character->GetActorLocation();
+		return ETeleportStageResult::Complete;
+	}
+
+	case ETeleportStage::Resolve:
+	{
+		// The snapshot holds raw anchor pointers. Once a newer table is published the anchors it dropped may be collected,
+		// so a search that finished against an older table is run again on the current one
+		const TSharedRef<const FTeleportAnchorTable> Table = WorldSubsystem->GetAnchorTable();
+		const bool bStaleTable = !bEntering && Pipeline.ResolveTask.IsCompleted() && Pipeline.AnchorTable.Get() != &Table.Get();
+		if (bEntering || bStaleTable)
+		{
+			const FVector SourceLocation = Pipeline.SourceLocation;
+			Pipeline.AnchorTable = Table;
+
+			auto FindNearest = [Table, SourceLocation]()
+			{
+				SCOPE_CYCLE_COUNTER(STAT_TeleportAnchorLookup);
+				FTeleportHitchScope HitchScope(ETeleportHitchSection::AnchorScan);
+				const uint64 StartCycles = FPlatformTime::Cycles64();
+
+				float MinDistSquared;
+				const int32 Nearest = Table->Locations.FindNearest(SourceLocation, MinDistSquared);
+
+				FTeleportMetrics::Get().AnchorLookups.Add();
+				FTeleportMetrics::Get().AnchorLookupCycles.Add(FPlatformTime::Cycles64() - StartCycles);
+				return Nearest;
+			};
+
+			if (Table->NumAnchors() >= AsyncResolveMinAnchors)
+			{
+				Pipeline.ResolveTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(FindNearest));
+			}
+			else
+			{
+				Pipeline.ResolveTask = UE::Tasks::MakeCompletedTask<int32>(FindNearest());
+			}
+		}
+
+		if (!Pipeline.ResolveTask.IsCompleted()) return ETeleportStageResult::Pending;
+
+		const int32 ClosestIndex = Pipeline.ResolveTask.GetResult();
+		if (ClosestIndex == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No closest anchor found"));
+			return ETeleportStageResult::Failed;
+		}
+
+		AAnchor* ClosestAnchor = Table->Locations.Anchors[ClosestIndex];
+		AAnchor* TargetAnchor = Table->FindPaired(ClosestIndex);
+		const bool bRemote = IsValid(ClosestAnchor) && ClosestAnchor->IsRemote();
+		if (!IsValid(ClosestAnchor) || (!bRemote && !IsValid(TargetAnchor)))
+		{
+			UE_LOG(LogTemp, Verbose, TEXT("No paired anchor found for %s"),
+			       IsValid(ClosestAnchor) ? *ClosestAnchor->AnchorID.ToString() : TEXT("a removed anchor"));
+			return ETeleportStageResult::Failed;
+		}
+
+		if (!WasRecentlyNear(ClosestAnchor))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s was not near anchor %s, teleport rejected"),
+			       *Character->GetName(), *ClosestAnchor->AnchorID.ToString());
+			return ETeleportStageResult::Failed;
+		}
+
+		if (bRemote && ClosestAnchor->DestinationAddress.IsEmpty())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Remote anchor %s has no DestinationAddress, teleport rejected"), *ClosestAnchor->AnchorID.ToString());
+			return ETeleportStageResult::Failed;
+		}
+
+		Pipeline.SourceAnchor = ClosestAnchor;
+		if (bRemote)
+		{
+			Pipeline.TravelURL = ClosestAnchor->GetTravelURL();
 		}
 		else
 		{
-			UE_LOG(LogTemp, Warning, TEXT("No teleportation charges left"));
-			return;
+			Pipeline.TargetAnchor = TargetAnchor;
 		}
+		return ETeleportStageResult::Complete;
 	}
-	else
+
+	case ETeleportStage::Admit:
+	{
+		if (!Pipeline.TravelURL.IsEmpty()) return ETeleportStageResult::Complete;
+
+		AAnchor* TargetAnchor = Pipeline.TargetAnchor.Get();
+		if (!TargetAnchor) return ETeleportStageResult::Failed;
+
+		if (bEntering)
+		{
+			if (TargetAnchor->ArrivalCapacity > 0 && TargetAnchor->bRedirectToSiblings && !WorldSubsystem->HasArrivalRoom(TargetAnchor))
+			{
+				// Not the Resolve snapshot, anchors may have left the world since then
+				const TSharedRef<const FTeleportAnchorTable> Table = WorldSubsystem->GetAnchorTable();
+				const int32 TargetIndex = Table->IndexOf(TargetAnchor);
+				if (TargetIndex != INDEX_NONE)
+				{
+					for (AAnchor* Sibling : Table->GetGroup(Table->Locations.GroupIndex[TargetIndex]))
+					{
+						if (Sibling == TargetAnchor || Sibling == Pipeline.SourceAnchor.Get() || !IsValid(Sibling) || Sibling->IsRemote()) continue;
+						if (!WorldSubsystem->HasArrivalRoom(Sibling)) continue;
+
+						UE_LOG(LogTemp, Log, TEXT("%s is full, %s lands at a sibling anchor instead"),
+						       *TargetAnchor->GetName(), *Character->GetName());
+						TargetAnchor = Sibling;
+						Pipeline.TargetAnchor = Sibling;
+						WorldSubsystem->CountRedirectedArrival();
+						break;
+					}
+				}
+			}
+
+			if (WorldSubsystem->RequestArrival(TargetAnchor, this)) return ETeleportStageResult::Complete;
+
+			Pipeline.QueuedAnchor = TargetAnchor;
+			UE_LOG(LogTemp, Log, TEXT("%s queued for arrival at %s"), *Character->GetName(), *TargetAnchor->GetName());
+		}
+
+		if (Pipeline.bArrivalAdmitted) return ETeleportStageResult::Complete;
+
+		if (StageElapsed >= TargetAnchor->MaxQueueTime)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s gave up waiting for room at %s"), *Character->GetName(), *TargetAnchor->GetName());
+			return ETeleportStageResult::Failed;
+		}
+		return ETeleportStageResult::Pending;
+	}
+
+	case ETeleportStage::PreloadDestination:
+	{
+		// Clients near a remote anchor stream its map in themselves
+		if (!Pipeline.TravelURL.IsEmpty()) return ETeleportStageResult::Complete;
+
+		AAnchor* TargetAnchor = Pipeline.TargetAnchor.Get();
+		if (!TargetAnchor) return ETeleportStageResult::Failed;
+
+		if (bEntering)
+		{
+			Pipeline.bDestinationRelevancySent = UAnchorTeleportationReplicationGraph::NotifyTeleportDestination(PlayerController, TargetAnchor->GetActorLocation());
+		}
+
+		// The graph only starts sending the destination actors now, give them a head start on the player
+		const bool bRelevancyLeadDone = !Pipeline.bDestinationRelevancySent || StageElapsed >= DestinationRelevancyLeadTime;
+		return (bRelevancyLeadDone && IsDestinationStreamedIn(TargetAnchor->GetActorLocation())) || StageElapsed >= DestinationPreloadTimeout
+			? ETeleportStageResult::Complete : ETeleportStageResult::Pending;
+	}
+
+	case ETeleportStage::ReserveLanding:
 	{
-		LastTeleportTimes.Add(PlayerController, GetWorld()->GetTimeSeconds());
+		if (!Pipeline.TravelURL.IsEmpty()) return ETeleportStageResult::Complete;
+
+		AAnchor* TargetAnchor = Pipeline.TargetAnchor.Get();
+		if (!TargetAnchor) return ETeleportStageResult::Failed;
+
+		const float Spacing = Character->GetCapsuleComponent()->GetScaledCapsuleRadius() * 2.f;
+		Pipeline.LandingLocation = WorldSubsystem->ReserveLandingSlot(TargetAnchor->GetActorLocation(), Spacing, Pipeline.LandingSlot);
+		World->FindTeleportSpot(Character, Pipeline.LandingLocation, Character->GetActorRotation());
+		return ETeleportStageResult::Complete;
 	}
 
-	FVector PlayerLocation = Character->GetActorLocation();
-	AAnchor* ClosestAnchor = nullptr;
-	float MinDistance = FLT_MAX;
+	case ETeleportStage::FadeOut:
+	{
+		if (bEntering)
+		{
+			SpawnAfterImage(Pipeline.SourceLocation, Character);
+			if (TeleportFadeOutTime > 0.f)
+			{
+				ClientTeleportFade(0.f, 1.f, TeleportFadeOutTime);
+			}
+		}
 
-	for (const FReplicatedAnchorList& AnchorList : AnchorPairs)
+		return StageElapsed >= TeleportFadeOutTime ? ETeleportStageResult::Complete : ETeleportStageResult::Pending;
+	}
+
+	case ETeleportStage::Move:
 	{
-		for (AAnchor* Anchor : AnchorList.Anchors)
+		AAnchor* SourceAnchor = Pipeline.SourceAnchor.Get();
+		AAnchor* TargetAnchor = Pipeline.TargetAnchor.Get();
+		if (!SourceAnchor || (!TargetAnchor && Pipeline.TravelURL.IsEmpty())) return ETeleportStageResult::Failed;
+
+		if (bEntering)
 		{
-			if (Anchor)
+			// Charges and cooldown are only spent once the teleport is known to go through
 			{
-				float Dist = FVector::Dist(PlayerLocation, Anchor->GetActorLocation());
-				if (Dist < MinDistance)
+				SCOPE_CYCLE_COUNTER(STAT_TeleportGating);
+
+				FTeleportGateContext Context{World->GetTimeSeconds(), FTeleportTuning::GetCooldown(TeleportCooldown), PickedUpPieces};
+				if (!GatingPolicy->Commit(Context)) return ETeleportStageResult::Failed;
+			}
+			UE_LOG(LogTemp, Log, TEXT("Teleport paid through the %s policy. Charges left: %d"),
+			       *GetGatingPolicyName().ToString(), PickedUpPieces);
+			if (!Pipeline.TravelURL.IsEmpty())
+			{
+				// The destination server places the player from this, not from the anchor in the URL
+				DepartureAnchorID = SourceAnchor->DestinationAnchorID;
+				DepartureUtc = FDateTime::UtcNow().ToUnixTimestampDecimal();
+			}
+			SavePersistentState();
+
+			if (!Pipeline.TravelURL.IsEmpty())
+			{
+				FTeleportTraceRecorder::Get().RecordTeleport(FTeleportTraceRecorder::GetPlayerId(PlayerController), Pipeline.SourceLocation,
+					SourceAnchor->AnchorID, SourceAnchor->DestinationAnchorID);
+
+				UGameInstance* GameInstance = World->GetGameInstance();
+				if (UTeleportPersistenceSubsystem* Persistence = GameInstance ? GameInstance->GetSubsystem<UTeleportPersistenceSubsystem>() : nullptr)
 				{
-					MinDistance = Dist;
-					ClosestAnchor = Anchor;
+					Pipeline.HandoffSaveStart = FPlatformTime::Seconds();
+					Pipeline.HandoffSave = Persistence->FlushPendingWrites();
 				}
 			}
 		}
+
+		if (!Pipeline.TravelURL.IsEmpty())
+		{
+			// The destination server reads the charges from the store as soon as the player arrives, so they go out first
+			if (!Pipeline.HandoffSave.IsCompleted()) return ETeleportStageResult::Pending;
+
+			// The player belongs to the destination server now, a late save from here would overwrite what it consumed
+			UGameInstance* GameInstance = World->GetGameInstance();
+			if (UTeleportPersistenceSubsystem* Persistence = GameInstance ? GameInstance->GetSubsystem<UTeleportPersistenceSubsystem>() : nullptr)
+			{
+				Persistence->RecordHandoffWait(FPlatformTime::Seconds() - Pipeline.HandoffSaveStart);
+				Persistence->Evict(PersistentPlayerKey);
+			}
+			PersistentPlayerKey.Reset();
+
+			UE_LOG(LogTemp, Log, TEXT("✅ ServerTeleportPlayer: %s leaves through %s to %s"),
+			       *Character->GetName(), *SourceAnchor->AnchorID.ToString(), *Pipeline.TravelURL);
+			ClientTravelToAnchor(Pipeline.TravelURL);
+			return ETeleportStageResult::Complete;
+		}
+
+		FTeleportTraceRecorder::Get().RecordTeleport(FTeleportTraceRecorder::GetPlayerId(PlayerController), Pipeline.SourceLocation,
+			SourceAnchor->AnchorID, TargetAnchor->AnchorID);
+
+		{
+			FTeleportHitchScope HitchScope(ETeleportHitchSection::Move);
+			TeleportMove(Character, Pipeline.LandingLocation);
+		}
+
+		// Hand the spot back only once the player had time to step off it, even with no fade in to cover the wait
+		WorldSubsystem->ReleaseLandingSlot(Pipeline.LandingSlot, LandingSettleTime);
+
+		if (USoundCue* SoundCue = TeleportSoundCue.Get())
+		{
+			UGameplayStatics::PlaySoundAtLocation(this, SoundCue, Pipeline.LandingLocation);
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("✅ ServerTeleportPlayer: %s teleported from %s to %s"),
+		       *Character->GetName(), *SourceAnchor->GetActorLocation().ToString(),
+		       *Pipeline.LandingLocation.ToString());
+		return ETeleportStageResult::Complete;
 	}
 
-	if (!ClosestAnchor)
+	case ETeleportStage::FadeIn:
 	{
-		UE_LOG(LogTemp, Warning, TEXT("No closest anchor found"));
-		return;
+		if (!Pipeline.TravelURL.IsEmpty()) return ETeleportStageResult::Complete;
+
+		if (bEntering && TeleportFadeInTime > 0.f)
+		{
+			ClientTeleportFade(1.f, 0.f, TeleportFadeInTime);
+		}
+
+		return StageElapsed >= TeleportFadeInTime ? ETeleportStageResult::Complete : ETeleportStageResult::Pending;
 	}
 
-	AAnchor* TargetAnchor = FindPairedAnchor(ClosestAnchor);
-	if (!TargetAnchor)
+	default:
+		return ETeleportStageResult::Failed;
+	}
+}
+
+void UTeleportationSubsystem::TeleportMove(AActor* Actor, const FVector& Location)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TeleportMove);
+
+	USceneComponent* Root = Actor ? Actor->GetRootComponent() : nullptr;
+	if (!Root) return;
+
 	{
-		UE_LOG(LogTemp, Warning, TEXT("No paired anchor found for %s"),
-		       *ClosestAnchor->AnchorID.ToString());
-		return;
+		// Attached components follow in the same pass, bounds, render state and overlaps are refreshed once when the scope closes
+		FScopedMovementUpdate ScopedMovement(Root, EScopedUpdate::DeferredUpdates);
+		Root->SetWorldLocation(Location, false, nullptr, ETeleportType::TeleportPhysics);
+	}
+
+	// Re-finds the floor and flags the move so it is not smoothed or treated as a sweep
+	if (const ACharacter* Character = Cast<ACharacter>(Actor))
+	{
+		if (UCharacterMovementComponent* Movement = Character->GetCharacterMovement())
+		{
+			Movement->OnTeleported();
+		}
 	}
+}
 
-	SpawnAfterImage(PlayerLocation, Character);
+bool UTeleportationSubsystem::IsDestinationStreamedIn(const FVector& Location) const
+{
+	const UWorldPartitionSubsystem* WorldPartitionSubsystem = GetWorld()->GetSubsystem<UWorldPartitionSubsystem>();
+	if (!WorldPartitionSubsystem || !GetWorld()->GetWorldPartition()) return true;
 
-	Character->SetActorLocation(TargetAnchor->GetActorLocation());
+	const TArray<FWorldPartitionStreamingQuerySource> QuerySources = { FWorldPartitionStreamingQuerySource(Location) };
+	return WorldPartitionSubsystem->IsStreamingCompleted(EWorldPartitionRuntimeCellState::Activated, QuerySources, false);
+}
 
-	if (TeleportSoundCue)
+void UTeleportationSubsystem::ClientTeleportFade_Implementation(float FromAlpha, float ToAlpha, float Duration)
+{
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	const APlayerController* PlayerController = Pawn ? Cast<APlayerController>(Pawn->GetController()) : nullptr;
+	if (PlayerController && PlayerController->PlayerCameraManager)
 	{
-		UGameplayStatics::PlaySoundAtLocation(this, TeleportSoundCue, TargetAnchor->GetActorLocation());
+		PlayerController->PlayerCameraManager->StartCameraFade(FromAlpha, ToAlpha, Duration, FLinearColor::Black, false, true);
+	}
+}
+
+EAfterImageLOD UTeleportationSubsystem::SelectAfterImageLOD(const FVector& Location) const
+{
+	const UTeleportationWorldSubsystem* WorldSubsystem = GetWorld()->GetSubsystem<UTeleportationWorldSubsystem>();
+	if (!WorldSubsystem || WorldSubsystem->NumGhosts() >= MaxConcurrentGhosts)
+	{
+		return EAfterImageLOD::Culled;
 	}
 
-	UE_LOG(LogTemp, Log, TEXT("✅ ServerTeleportPlayer: %s teleported from %s to %s"),
-	       *Character->GetName(), *ClosestAnchor->GetActorLocation().ToString(),
-	       *TargetAnchor->GetActorLocation().ToString());
+	EAfterImageLOD LOD = EAfterImageLOD::Full;
+	if (const APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this, 0))
+	{
+		const double DistSquared = FVector::DistSquared(CameraManager->GetCameraLocation(), Location);
+		if (DistSquared > FMath::Square(AfterImageCullDistance))
+		{
+			return EAfterImageLOD::Culled;
+		}
+		if (DistSquared > FMath::Square(AfterImageFullDetailDistance))
+		{
+			LOD = EAfterImageLOD::Impostor;
+		}
+	}
+
+	if (LOD == EAfterImageLOD::Full && WorldSubsystem->NumGhosts(EAfterImageLOD::Full) >= MaxFullDetailGhosts)
+	{
+		LOD = EAfterImageLOD::Impostor;
+	}
+	return LOD;
 }
 
 void UTeleportationSubsystem::SpawnAfterImage_Implementation(FVector Location, ACharacter* OriginalCharacter)
 {
+    SCOPE_CYCLE_COUNTER(STAT_TeleportSpawnAfterImage);
+
     if (!OriginalCharacter) return;
 
     UWorld* World = GetWorld();
     if (!World) return;
-	
-    ACharacter* GhostCharacter = World->SpawnActor<ACharacter>(OriginalCharacter->GetClass(), Location,
-                                                               OriginalCharacter->GetActorRotation());
-    if (!GhostCharacter) return;
 
-    GhostCharacter->SetActorEnableCollision(false);
-    GhostCharacter->SetReplicates(false);
-    GhostCharacter->GetMesh()->SetRenderCustomDepth(true);
-	
-    UMaterialInstanceDynamic* DynamicMaterial = GhostCharacter->GetMesh()->CreateDynamicMaterialInstance(
-        0, GhostMaterial);
+    // Nobody can see the ghost on a dedicated server
+    if (World->GetNetMode() == NM_DedicatedServer) return;
+
+    // Skip the ghost until the effect assets have streamed in
+    UMaterialInterface* Material = GhostMaterial.Get();
+    if (!Material) return;
+
+    const EAfterImageLOD LOD = SelectAfterImageLOD(Location);
+    if (LOD == EAfterImageLOD::Culled) return;
+
+    AActor* Ghost = nullptr;
+    UMeshComponent* GhostMesh = nullptr;
+
+    UStaticMesh* ImpostorMesh = GhostImpostorMesh.Get();
+    if (LOD == EAfterImageLOD::Impostor && ImpostorMesh)
+    {
+        AStaticMeshActor* Impostor;
+        {
+            FTeleportHitchScope SpawnHitchScope(ETeleportHitchSection::GhostSpawn);
+            Impostor = World->SpawnActor<AStaticMeshActor>(Location, OriginalCharacter->GetActorRotation());
+        }
+        if (!Impostor) return;
+
+        Impostor->SetMobility(EComponentMobility::Movable);
+        Impostor->SetActorEnableCollision(false);
+        Impostor->GetStaticMeshComponent()->SetStaticMesh(ImpostorMesh);
+        Impostor->GetStaticMeshComponent()->SetCastShadow(false);
+
+        Ghost = Impostor;
+        GhostMesh = Impostor->GetStaticMeshComponent();
+    }
+    else
+    {
+        ACharacter* GhostCharacter;
+        {
+            FTeleportHitchScope SpawnHitchScope(ETeleportHitchSection::GhostSpawn);
+            GhostCharacter = World->SpawnActorDeferred<ACharacter>(OriginalCharacter->GetClass(),
+                                                                   FTransform(OriginalCharacter->GetActorRotation(), Location));
+            if (!GhostCharacter) return;
+
+            // Tagged before the construction script runs so Blueprint-added components see it too
+            GhostCharacter->Tags.Add(AfterImageTag);
+            GhostCharacter->FinishSpawning(FTransform(OriginalCharacter->GetActorRotation(), Location));
+        }
+
+        GhostCharacter->SetActorEnableCollision(false);
+        GhostCharacter->SetReplicates(false);
+        GhostCharacter->GetMesh()->SetRenderCustomDepth(LOD == EAfterImageLOD::Full);
+
+        Ghost = GhostCharacter;
+        GhostMesh = GhostCharacter->GetMesh();
+    }
+
+    UTeleportationWorldSubsystem* WorldSubsystem = World->GetSubsystem<UTeleportationWorldSubsystem>();
+
+    UMaterialInstanceDynamic* DynamicMaterial = WorldSubsystem->AcquireGhostMaterial(Material);
     if (!DynamicMaterial)
     {
         UE_LOG(LogTemp, Warning, TEXT("Failed to create dynamic material instance"));
-        GhostCharacter->Destroy();
+        Ghost->Destroy();
         return;
     }
-	
-    GhostCharacter->GetMesh()->SetMaterial(0, DynamicMaterial);
-	
+
+    GhostMesh->SetMaterial(0, DynamicMaterial);
+
     DynamicMaterial->SetScalarParameterValue(TEXT("Opacity"), 1.0f);
-	
-    float LocalFadeDuration = FadeDuration;
+
+    WorldSubsystem->RegisterGhost(Ghost, LOD);
+
+    StartAfterImageFade(Ghost, DynamicMaterial);
+}
+
+void UTeleportationSubsystem::StartAfterImageFade(AActor* Ghost, UMaterialInstanceDynamic* DynamicMaterial)
+{
+    UWorld* World = GetWorld();
+
+    float LocalFadeDuration = FTeleportTuning::GetFadeDuration(FadeDuration);
     float FadeStepTime = 0.05f;
-	
-    TWeakObjectPtr<ACharacter> WeakGhostCharacter(GhostCharacter);
-	
+
+    TWeakObjectPtr<AActor> WeakGhost(Ghost);
+    TWeakObjectPtr<UMaterialInstanceDynamic> WeakMaterial(DynamicMaterial);
+    TWeakObjectPtr<UTeleportationWorldSubsystem> WeakWorldSubsystem(World->GetSubsystem<UTeleportationWorldSubsystem>());
+
     TSharedPtr<FTimerHandle> FadeTimerHandle = MakeShared<FTimerHandle>();
-	
-    float* ElapsedTime = new float(0.0f);
 
-    World->GetTimerManager().SetTimer(*FadeTimerHandle, [WeakGhostCharacter, DynamicMaterial, World, LocalFadeDuration, FadeStepTime, FadeTimerHandle, ElapsedTime]()
+    TSharedRef<float> ElapsedTime = MakeShared<float>(0.0f);
+
+    World->GetTimerManager().SetTimer(*FadeTimerHandle, [WeakGhost, WeakMaterial, WeakWorldSubsystem, World, LocalFadeDuration, FadeStepTime, FadeTimerHandle, ElapsedTime]()
     {
-        if (!WeakGhostCharacter.IsValid() || !DynamicMaterial) 
+        UMaterialInstanceDynamic* Material = WeakMaterial.Get();
+        if (!WeakGhost.IsValid() || !Material)
         {
+            if (WeakWorldSubsystem.IsValid())
+            {
+                WeakWorldSubsystem->ReleaseGhostMaterial(Material);
+            }
             World->GetTimerManager().ClearTimer(*FadeTimerHandle);
-            delete ElapsedTime;
             return;
         }
 
-        ACharacter* GhostChar = WeakGhostCharacter.Get();
-        if (!GhostChar) return;
-    	
+        AActor* GhostActor = WeakGhost.Get();
+
         *ElapsedTime += FadeStepTime;
-    	
+
         float NewOpacity = FMath::Clamp(1.0f - (*ElapsedTime / LocalFadeDuration), 0.0f, 1.0f);
-        DynamicMaterial->SetScalarParameterValue(TEXT("Opacity"), NewOpacity);
-    	
+        Material->SetScalarParameterValue(TEXT("Opacity"), NewOpacity);
+
         if (*ElapsedTime >= LocalFadeDuration)
         {
-            GhostChar->Destroy();
+            GhostActor->Destroy();
+            if (WeakWorldSubsystem.IsValid())
+            {
+                WeakWorldSubsystem->ReleaseGhostMaterial(Material);
+            }
             World->GetTimerManager().ClearTimer(*FadeTimerHandle);
-            delete ElapsedTime;
         }
     }, FadeStepTime, true);
-}
\ No newline at end of file
+}
@@ -0,0 +1,720 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportationWorldSubsystem.h"
+#include "Anchor.h"
+#include "EngineUtils.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/StaticMesh.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "MaterialShared.h"
+#include "Misc/App.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Pieces/BigTeleportationPiece.h"
+#include "Pieces/SmallTeleportationPieces.h"
+#include "Pieces/TeleportationPieceManager.h"
+#if !UE_BUILD_SHIPPING
+#include "TeleportBotComponent.h"
+#endif
+#include "TeleportHitchDetector.h"
+#include "TeleportMetrics.h"
+#include "TeleportationStats.h"
+#include "TeleportationSubsystem.h"
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GTeleportMemReportCommand(
+	TEXT("teleport.memreport"),
+	TEXT("Prints the bytes used by the teleport anchor table, components, timer wheel, ghost pool and piece manager"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		if (UTeleportationWorldSubsystem* WorldSubsystem = World ? World->GetSubsystem<UTeleportationWorldSubsystem>() : nullptr)
+		{
+			WorldSubsystem->DumpMemoryReport(Ar);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GTeleportPipelineStatsCommand(
+	TEXT("teleport.pipeline.stats"),
+	TEXT("Prints how long each teleport stage took on this server, averaged over every teleport so far"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		if (UTeleportationWorldSubsystem* WorldSubsystem = World ? World->GetSubsystem<UTeleportationWorldSubsystem>() : nullptr)
+		{
+			WorldSubsystem->DumpPipelineStats(Ar);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GTeleportLoadReportCommand(
+	TEXT("teleport.loadreport"),
+	TEXT("Prints server frame time, teleport RPC rates, bandwidth per connection and teleport latency percentiles. Pass 'reset' to start a new window"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		if (UTeleportationWorldSubsystem* WorldSubsystem = World ? World->GetSubsystem<UTeleportationWorldSubsystem>() : nullptr)
+		{
+			WorldSubsystem->DumpLoadReport(Ar);
+			if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+			{
+				WorldSubsystem->ResetLoadReport();
+			}
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GTeleportStatsCommand(
+	TEXT("teleport.stats"),
+	TEXT("Prints rolling teleport and reject rates, average anchor lookup time, live pieces and ghosts and ghost material pool use"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		if (UTeleportationWorldSubsystem* WorldSubsystem = World ? World->GetSubsystem<UTeleportationWorldSubsystem>() : nullptr)
+		{
+			WorldSubsystem->DumpStats(Ar);
+		}
+	}));
+
+namespace TeleportLoadReport
+{
+	constexpr int32 MaxSamples = 16384;
+
+	float Percentile(TArray<float> Samples, float P)
+	{
+		if (Samples.Num() == 0) return 0.f;
+
+		Samples.Sort();
+		return Samples[FMath::Clamp(FMath::CeilToInt(P * Samples.Num()) - 1, 0, Samples.Num() - 1)];
+	}
+
+	void AddSample(TArray<float>& Samples, float Value)
+	{
+		// Keep the most recent window once full
+		if (Samples.Num() >= MaxSamples)
+		{
+			Samples.RemoveAt(0, MaxSamples / 2, EAllowShrinking::No);
+		}
+		Samples.Add(Value);
+	}
+}
+
+const TCHAR* LexToString(ETeleportStage Stage)
+{
+	switch (Stage)
+	{
+	case ETeleportStage::Validate: return TEXT("Validate");
+	case ETeleportStage::Resolve: return TEXT("Resolve");
+	case ETeleportStage::Admit: return TEXT("Admit");
+	case ETeleportStage::PreloadDestination: return TEXT("PreloadDestination");
+	case ETeleportStage::ReserveLanding: return TEXT("ReserveLanding");
+	case ETeleportStage::FadeOut: return TEXT("FadeOut");
+	case ETeleportStage::Move: return TEXT("Move");
+	case ETeleportStage::FadeIn: return TEXT("FadeIn");
+	default: return TEXT("Unknown");
+	}
+}
+
+void UTeleportationWorldSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	ResetLoadReport();
+}
+
+void UTeleportationWorldSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TeleportLoadReport::AddSample(FrameTimes, static_cast<float>(FMath::Max(FApp::GetDeltaTime() - FApp::GetIdleTime(), 0.0)));
+
+#if !UE_BUILD_SHIPPING
+	if (GetWorld()->GetNetMode() == NM_Client)
+	{
+		UpdateBot();
+	}
+#endif
+
+	if (bAnchorTableChanged)
+	{
+		bAnchorTableChanged = false;
+		GetAnchorTable();
+		OnAnchorTableChanged.Broadcast();
+	}
+
+	AnchorRegistry->Reclaim();
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TeleportPipelineTick);
+
+		// Admitted players move on with this frame's pipeline tick
+		TickArrivalQueues();
+
+		for (int32 Index = ActiveTeleports.Num() - 1; Index >= 0; Index--)
+		{
+			UTeleportationSubsystem* Component = ActiveTeleports[Index].Get();
+			if (!Component || !Component->TickTeleport())
+			{
+				ActiveTeleports.RemoveAtSwap(Index);
+			}
+		}
+		SET_DWORD_STAT(STAT_TeleportActivePipelines, ActiveTeleports.Num());
+	}
+
+	const int32 NumFired = TimerWheel.Advance(DeltaTime);
+	INC_DWORD_STAT_BY(STAT_TeleportTimerWheelFired, NumFired);
+	SET_DWORD_STAT(STAT_TeleportTimerWheelEntries, TimerWheel.Num());
+
+	if (FTeleportHitchDetector::IsEnabled())
+	{
+		FTeleportHitchWorldCounts Counts;
+		Counts.Anchors = RegisteredAnchors.Num();
+		Counts.ActiveTeleports = ActiveTeleports.Num();
+		Counts.Ghosts = NumGhosts();
+		Counts.FreeGhostMaterials = FreeGhostMaterials.Num();
+		Counts.Pieces = PieceManager ? PieceManager->NumPieces() : 0;
+		FTeleportHitchDetector::Get().EndFrame(GetWorld(), Counts);
+	}
+}
+
+TStatId UTeleportationWorldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTeleportationWorldSubsystem, STATGROUP_AnchorTeleportation);
+}
+
+void UTeleportationWorldSubsystem::RegisterAnchor(AAnchor* Anchor)
+{
+	if (!Anchor || RegisteredAnchorIndices.Contains(Anchor)) return;
+
+	RegisteredAnchorIndices.Add(Anchor, RegisteredAnchors.Add(Anchor));
+	bAnchorTableDirty = true;
+	bAnchorTableChanged = true;
+}
+
+void UTeleportationWorldSubsystem::UnregisterAnchor(AAnchor* Anchor)
+{
+	int32 Index;
+	if (!RegisteredAnchorIndices.RemoveAndCopyValue(Anchor, Index)) return;
+
+	// The last anchor fills the hole, its index moves with it
+	RegisteredAnchors.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	if (RegisteredAnchors.IsValidIndex(Index))
+	{
+		RegisteredAnchorIndices.Add(RegisteredAnchors[Index].Get(), Index);
+	}
+
+	if (FAnchorAdmission* Admission = Admissions.Find(Anchor))
+	{
+		// Cancelling leaves the queue, so it is taken out of the map before anyone is cancelled
+		const TArray<TWeakObjectPtr<UTeleportationSubsystem>> Queue = MoveTemp(Admission->Queue);
+		Admissions.Remove(Anchor);
+
+		for (const TWeakObjectPtr<UTeleportationSubsystem>& Queued : Queue)
+		{
+			if (UTeleportationSubsystem* Component = Queued.Get())
+			{
+				if (Component->ActiveTeleport)
+				{
+					Component->ActiveTeleport->QueuedAnchor.Reset();
+				}
+				Component->CancelTeleport(TEXT("the target anchor was removed"));
+			}
+		}
+	}
+
+	bAnchorTableDirty = true;
+	bAnchorTableChanged = true;
+}
+
+TSharedRef<const FTeleportAnchorTable> UTeleportationWorldSubsystem::GetAnchorTable()
+{
+	if (bAnchorTableDirty)
+	{
+		bAnchorTableDirty = false;
+		AnchorRegistry->Publish(FTeleportAnchorTable::Build(ObjectPtrDecay(RegisteredAnchors)));
+	}
+	return AnchorRegistry->Read();
+}
+
+void UTeleportationWorldSubsystem::DumpMemoryReport(FOutputDevice& Ar)
+{
+	const TSharedRef<const FTeleportAnchorTable> Table = GetAnchorTable();
+	const FAnchorLocationCache& Locations = Table->Locations;
+	const SIZE_T PairingBytes = Locations.Anchors.GetAllocatedSize() + Locations.GroupIndex.GetAllocatedSize() + Table->GroupStarts.GetAllocatedSize()
+		+ Table->PairedIndex.GetAllocatedSize() + Table->AnchorIndices.GetAllocatedSize();
+	const SIZE_T PositionBytes = Locations.X.GetAllocatedSize() + Locations.Y.GetAllocatedSize() + Locations.Z.GetAllocatedSize();
+	const int32 NumAnchors = FMath::Max(Table->NumAnchors(), 1);
+
+	Ar.Logf(TEXT("Teleport memory report for %s"), *GetWorld()->GetName());
+	Ar.Logf(TEXT("  Anchor table: %d anchors in %d groups, %llu bytes (pairing %.1f bytes/anchor, positions %.1f bytes/anchor)"),
+		Table->NumAnchors(), Table->NumGroups(), static_cast<uint64>(Table->GetAllocatedSize()),
+		static_cast<double>(PairingBytes) / NumAnchors, static_cast<double>(PositionBytes) / NumAnchors);
+	const SIZE_T RegisteredBytes = RegisteredAnchors.GetAllocatedSize() + RegisteredAnchorIndices.GetAllocatedSize();
+	Ar.Logf(TEXT("  Registered anchor list: %llu bytes"), static_cast<uint64>(RegisteredBytes));
+
+	int32 NumComponents = 0;
+	SIZE_T ComponentBytes = 0;
+	SIZE_T AnchorListBytes = 0;
+	for (TObjectIterator<UTeleportationSubsystem> It; It; ++It)
+	{
+		if (It->GetWorld() == GetWorld())
+		{
+			NumComponents++;
+			ComponentBytes += It->GetClass()->GetStructureSize() + It->GetAllocatedSize();
+			AnchorListBytes += It->GetAnchorListAllocatedSize();
+		}
+	}
+	Ar.Logf(TEXT("  Teleport components: %d, %llu bytes"), NumComponents, static_cast<uint64>(ComponentBytes));
+
+	// Everything that grows with the anchor count: the table, the registered list and each component's group list
+	const SIZE_T PerAnchorBytes = Table->GetAllocatedSize() + RegisteredBytes + AnchorListBytes;
+	Ar.Logf(TEXT("  Per anchor: %.1f bytes (table %.1f, registered list %.1f, component group lists %.1f)"),
+		static_cast<double>(PerAnchorBytes) / NumAnchors, static_cast<double>(Table->GetAllocatedSize()) / NumAnchors,
+		static_cast<double>(RegisteredBytes) / NumAnchors, static_cast<double>(AnchorListBytes) / NumAnchors);
+
+	Ar.Logf(TEXT("  Timer wheel: %d entries, %llu bytes"), TimerWheel.Num(), static_cast<uint64>(TimerWheel.GetAllocatedSize()));
+	Ar.Logf(TEXT("  Ghosts: %d active, %d pooled materials, %llu bytes"), NumGhosts(),
+		FreeGhostMaterials.Num() + InUseGhostMaterials.Num(),
+		static_cast<uint64>(ActiveGhosts.GetAllocatedSize() + FreeGhostMaterials.GetAllocatedSize() + InUseGhostMaterials.GetAllocatedSize()));
+
+	if (IsValid(PieceManager))
+	{
+		Ar.Logf(TEXT("  Piece manager: %d pieces, %llu bytes"), PieceManager->NumPieces(), static_cast<uint64>(PieceManager->GetAllocatedSize()));
+	}
+}
+
+void UTeleportationWorldSubsystem::StartTeleport(UTeleportationSubsystem* Component)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TeleportPipelineTick);
+
+	if (Component && Component->TickTeleport())
+	{
+		ActiveTeleports.AddUnique(Component);
+	}
+}
+
+void UTeleportationWorldSubsystem::RecordTeleportLatency(double Seconds)
+{
+	TeleportLoadReport::AddSample(TeleportLatencies, static_cast<float>(Seconds));
+}
+
+void UTeleportationWorldSubsystem::CountServerRpc(ETeleportServerRpc Rpc)
+{
+	ServerRpcCounts[static_cast<int32>(Rpc)]++;
+}
+
+void UTeleportationWorldSubsystem::ResetLoadReport()
+{
+	LoadReportStartTime = FPlatformTime::Seconds();
+	FMemory::Memzero(ServerRpcCounts);
+	NumQueuedArrivals = 0;
+	NumRedirectedArrivals = 0;
+	MaxArrivalQueue = 0;
+	FrameTimes.Reset();
+	TeleportLatencies.Reset();
+}
+
+void UTeleportationWorldSubsystem::DumpLoadReport(FOutputDevice& Ar) const
+{
+	const double Elapsed = FMath::Max(FPlatformTime::Seconds() - LoadReportStartTime, UE_DOUBLE_SMALL_NUMBER);
+
+	Ar.Logf(TEXT("Teleport load report for %s over %.1f s"), *GetWorld()->GetName(), Elapsed);
+
+	float FrameTotal = 0.f;
+	for (float FrameTime : FrameTimes)
+	{
+		FrameTotal += FrameTime;
+	}
+	Ar.Logf(TEXT("  Frame time: avg %.2f ms, p99 %.2f ms over %d frames"),
+		FrameTimes.Num() > 0 ? FrameTotal * 1000.f / FrameTimes.Num() : 0.f,
+		TeleportLoadReport::Percentile(FrameTimes, 0.99f) * 1000.f, FrameTimes.Num());
+
+	Ar.Logf(TEXT("  Server RPCs/s: teleport %.1f, collect %.1f, break %.1f"),
+		ServerRpcCounts[static_cast<int32>(ETeleportServerRpc::Teleport)] / Elapsed,
+		ServerRpcCounts[static_cast<int32>(ETeleportServerRpc::CollectPiece)] / Elapsed,
+		ServerRpcCounts[static_cast<int32>(ETeleportServerRpc::BreakSource)] / Elapsed);
+
+	if (const UNetDriver* NetDriver = GetWorld()->GetNetDriver())
+	{
+		int64 InTotal = 0;
+		int64 OutTotal = 0;
+		int32 OutMax = 0;
+		for (const UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			InTotal += Connection->InBytesPerSecond;
+			OutTotal += Connection->OutBytesPerSecond;
+			OutMax = FMath::Max(OutMax, Connection->OutBytesPerSecond);
+		}
+		const int32 NumConnections = FMath::Max(NetDriver->ClientConnections.Num(), 1);
+		Ar.Logf(TEXT("  Connections: %d, avg in %lld B/s, avg out %lld B/s, max out %d B/s"),
+			NetDriver->ClientConnections.Num(), InTotal / NumConnections, OutTotal / NumConnections, OutMax);
+	}
+
+	Ar.Logf(TEXT("  Teleport latency: %d teleports, p50 %.1f ms, p95 %.1f ms, p99 %.1f ms"), TeleportLatencies.Num(),
+		TeleportLoadReport::Percentile(TeleportLatencies, 0.5f) * 1000.f,
+		TeleportLoadReport::Percentile(TeleportLatencies, 0.95f) * 1000.f,
+		TeleportLoadReport::Percentile(TeleportLatencies, 0.99f) * 1000.f);
+
+	Ar.Logf(TEXT("  Arrival queues: %d queued, %d redirected to a sibling, longest queue %d"),
+		NumQueuedArrivals, NumRedirectedArrivals, MaxArrivalQueue);
+}
+
+void UTeleportationWorldSubsystem::RefillArrivals(FAnchorAdmission& Admission, const AAnchor& Anchor) const
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	const float Rate = Anchor.ArrivalCapacity / FMath::Max(Anchor.ArrivalWindow, UE_KINDA_SMALL_NUMBER);
+	Admission.Tokens = FMath::Min(Admission.Tokens + static_cast<float>(Now - Admission.LastRefillTime) * Rate,
+		static_cast<float>(Anchor.ArrivalCapacity));
+	Admission.LastRefillTime = Now;
+}
+
+bool UTeleportationWorldSubsystem::HasArrivalRoom(const AAnchor* Anchor)
+{
+	if (!Anchor || Anchor->ArrivalCapacity <= 0) return true;
+
+	FAnchorAdmission* Admission = Admissions.Find(Anchor);
+	if (!Admission) return true;
+
+	RefillArrivals(*Admission, *Anchor);
+	return Admission->Queue.Num() == 0 && Admission->Tokens >= 1.f;
+}
+
+bool UTeleportationWorldSubsystem::RequestArrival(AAnchor* Anchor, UTeleportationSubsystem* Component)
+{
+	if (!Anchor || Anchor->ArrivalCapacity <= 0) return true;
+
+	FAnchorAdmission* Admission = Admissions.Find(Anchor);
+	if (!Admission)
+	{
+		// A fresh anchor starts with a full window
+		Admission = &Admissions.Add(Anchor);
+		Admission->Tokens = Anchor->ArrivalCapacity;
+		Admission->LastRefillTime = GetWorld()->GetTimeSeconds();
+	}
+
+	RefillArrivals(*Admission, *Anchor);
+	if (Admission->Queue.Num() == 0 && Admission->Tokens >= 1.f)
+	{
+		Admission->Tokens -= 1.f;
+		return true;
+	}
+
+	Admission->Queue.Add(Component);
+	NumQueuedArrivals++;
+	MaxArrivalQueue = FMath::Max(MaxArrivalQueue, Admission->Queue.Num());
+	return false;
+}
+
+void UTeleportationWorldSubsystem::LeaveArrivalQueue(AAnchor* Anchor, UTeleportationSubsystem* Component)
+{
+	if (FAnchorAdmission* Admission = Admissions.Find(Anchor))
+	{
+		Admission->Queue.RemoveSingle(Component);
+	}
+}
+
+void UTeleportationWorldSubsystem::TickArrivalQueues()
+{
+	for (auto It = Admissions.CreateIterator(); It; ++It)
+	{
+		FAnchorAdmission& Admission = It.Value();
+		const AAnchor* Anchor = It.Key().ResolveObjectPtr();
+		if (!Anchor)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		if (Admission.Queue.Num() == 0) continue;
+
+		RefillArrivals(Admission, *Anchor);
+
+		int32 NumAdmitted = 0;
+		while (NumAdmitted < Admission.Queue.Num() && Admission.Tokens >= 1.f)
+		{
+			if (UTeleportationSubsystem* Component = Admission.Queue[NumAdmitted].Get())
+			{
+				Admission.Tokens -= 1.f;
+				Component->OnArrivalAdmitted();
+			}
+			NumAdmitted++;
+		}
+		Admission.Queue.RemoveAt(0, NumAdmitted, EAllowShrinking::No);
+
+		// Components only touch their replicated status when the estimate drifts
+		const float Rate = Anchor->ArrivalCapacity / FMath::Max(Anchor->ArrivalWindow, UE_KINDA_SMALL_NUMBER);
+		for (int32 Index = 0; Index < Admission.Queue.Num(); Index++)
+		{
+			if (UTeleportationSubsystem* Component = Admission.Queue[Index].Get())
+			{
+				Component->UpdateArrivalQueueStatus(Index + 1, (Index + 1 - Admission.Tokens) / Rate);
+			}
+		}
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+void UTeleportationWorldSubsystem::UpdateBot()
+{
+	if (!bBotMixParsed)
+	{
+		bBotMixParsed = true;
+		UTeleportBotComponent::GetCommandLineMix(BotMix);
+	}
+	if (BotMix.IsEmpty()) return;
+
+	// The pawn can change on respawn, each new one gets a bot
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+	if (Pawn && !Pawn->FindComponentByClass<UTeleportBotComponent>())
+	{
+		UTeleportBotComponent* Bot = NewObject<UTeleportBotComponent>(Pawn);
+		Bot->SetBehaviorMix(BotMix);
+		Bot->RegisterComponent();
+	}
+}
+#endif
+
+void UTeleportationWorldSubsystem::RecordStageLatency(ETeleportStage Stage, double Seconds)
+{
+	StageMetrics[static_cast<int32>(Stage)].Add(Seconds);
+}
+
+void UTeleportationWorldSubsystem::DumpStats(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("Teleport stats for %s"), *GetWorld()->GetName());
+	FTeleportMetrics::Get().Dump(Ar);
+
+	// Pieces live in the manager or as actors spawned locally from a replicated break, depending on the source
+	int32 NumPieceActors = 0;
+	for (const ASmallTeleportationPieces* Piece : TActorRange<ASmallTeleportationPieces>(GetWorld()))
+	{
+		NumPieceActors += Piece->bIsCollected ? 0 : 1;
+	}
+	int32 NumBreaks = 0;
+	for (const ABigTeleportationPiece* Source : TActorRange<ABigTeleportationPiece>(GetWorld()))
+	{
+		NumBreaks += Source->ActiveBreaks.Num();
+	}
+	const int32 NumManagedPieces = PieceManager ? PieceManager->NumPieces() : 0;
+
+	Ar.Logf(TEXT("  Live: %d pieces (%d managed, %d actors from %d breaks), %d ghosts, %d teleports in flight"),
+		NumManagedPieces + NumPieceActors, NumManagedPieces, NumPieceActors, NumBreaks, NumGhosts(), ActiveTeleports.Num());
+
+	const int32 PoolSize = InUseGhostMaterials.Num() + FreeGhostMaterials.Num();
+	Ar.Logf(TEXT("  Ghost material pool: %d of %d in use (%.0f%%)"), InUseGhostMaterials.Num(), PoolSize,
+		PoolSize > 0 ? 100.f * InUseGhostMaterials.Num() / PoolSize : 0.f);
+}
+
+void UTeleportationWorldSubsystem::DumpPipelineStats(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("Teleport pipeline for %s, %d in flight"), *GetWorld()->GetName(), ActiveTeleports.Num());
+	for (int32 Stage = 0; Stage < static_cast<int32>(ETeleportStage::Num); Stage++)
+	{
+		const FTeleportStageMetrics& Metrics = StageMetrics[Stage];
+		Ar.Logf(TEXT("  %-20s %6d runs, avg %8.3f ms, max %8.3f ms"), LexToString(static_cast<ETeleportStage>(Stage)), Metrics.Count,
+			Metrics.Count > 0 ? Metrics.TotalSeconds * 1000.0 / Metrics.Count : 0.0, Metrics.MaxSeconds * 1000.0);
+	}
+}
+
+FVector UTeleportationWorldSubsystem::ReserveLandingSlot(const FVector& Location, float Spacing, int32& OutSlot)
+{
+	// Anchor first, then rings of six around it
+	FVector Candidate = Location;
+	for (int32 Attempt = 0; Attempt < 19; Attempt++)
+	{
+		if (Attempt > 0)
+		{
+			const int32 Ring = Attempt <= 6 ? 1 : 2;
+			const int32 PerRing = 6 * Ring;
+			const float Angle = 2.f * PI * ((Attempt - 1 - (Ring - 1) * 6) % PerRing) / PerRing;
+			Candidate = Location + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * Spacing * Ring;
+		}
+
+		bool bTaken = false;
+		for (const FVector& Reserved : ReservedLandings)
+		{
+			if (FVector::DistSquared2D(Reserved, Candidate) < FMath::Square(Spacing))
+			{
+				bTaken = true;
+				break;
+			}
+		}
+		if (!bTaken) break;
+	}
+
+	OutSlot = ReservedLandings.Add(Candidate);
+	return Candidate;
+}
+
+void UTeleportationWorldSubsystem::ReleaseLandingSlot(int32& Slot, float SettleTime)
+{
+	if (SettleTime > 0.f && ReservedLandings.IsValidIndex(Slot))
+	{
+		TimerWheel.Schedule(SettleTime, FSimpleDelegate::CreateUObject(this, &UTeleportationWorldSubsystem::FreeLandingSlot, Slot));
+	}
+	else
+	{
+		FreeLandingSlot(Slot);
+	}
+	Slot = INDEX_NONE;
+}
+
+void UTeleportationWorldSubsystem::FreeLandingSlot(int32 Slot)
+{
+	if (ReservedLandings.IsValidIndex(Slot))
+	{
+		ReservedLandings.RemoveAt(Slot);
+	}
+}
+
+void UTeleportationWorldSubsystem::RegisterGhost(AActor* Ghost, EAfterImageLOD LOD)
+{
+	if (!Ghost) return;
+
+	PruneGhosts();
+	ActiveGhosts.Add({ Ghost, LOD });
+}
+
+int32 UTeleportationWorldSubsystem::NumGhosts() const
+{
+	PruneGhosts();
+	return ActiveGhosts.Num();
+}
+
+int32 UTeleportationWorldSubsystem::NumGhosts(EAfterImageLOD LOD) const
+{
+	PruneGhosts();
+
+	int32 Count = 0;
+	for (const FActiveGhost& Entry : ActiveGhosts)
+	{
+		if (Entry.LOD == LOD)
+		{
+			Count++;
+		}
+	}
+	return Count;
+}
+
+void UTeleportationWorldSubsystem::PruneGhosts() const
+{
+	ActiveGhosts.RemoveAllSwap([](const FActiveGhost& Entry) { return !Entry.Ghost.IsValid(); });
+}
+
+bool UTeleportationWorldSubsystem::MarkPrewarmed(const UObject* Asset, const UObject* Material)
+{
+	bool bAlreadyPrewarmed = false;
+	PrewarmedEffects.Add(TPair<FObjectKey, FObjectKey>(Asset, Material), &bAlreadyPrewarmed);
+	return !bAlreadyPrewarmed;
+}
+
+void UTeleportationWorldSubsystem::PrewarmEffects(USoundCue* SoundCue, UMaterialInterface* GhostMaterial, int32 GhostMaterialPoolSize,
+	USkeletalMesh* SkeletalMesh, UStaticMesh* ImpostorMesh)
+{
+	if (SoundCue && MarkPrewarmed(SoundCue))
+	{
+		UGameplayStatics::PrimeSound(SoundCue);
+	}
+
+	if (!GhostMaterial) return;
+
+	if (MarkPrewarmed(GhostMaterial))
+	{
+#if WITH_EDITOR
+		// Cooked builds load the shader map with the material, the editor compiles it on first use
+		if (FMaterialResource* MaterialResource = GhostMaterial->GetMaterialResource(GetWorld()->GetFeatureLevel()))
+		{
+			MaterialResource->FinishCompilation();
+		}
+#endif
+	}
+
+	PrewarmGhostMaterials(GhostMaterial, GhostMaterialPoolSize);
+
+	// Request PSOs for both ghost representations so they are compiled now and end up in the recorded PSO cache
+	if (SkeletalMesh && MarkPrewarmed(SkeletalMesh, GhostMaterial))
+	{
+		USkeletalMeshComponent* WarmupMesh = NewObject<USkeletalMeshComponent>(this);
+		WarmupMesh->SetSkeletalMesh(SkeletalMesh);
+		WarmupMesh->SetMaterial(0, GhostMaterial);
+		WarmupMesh->SetRenderCustomDepth(true);
+		WarmupMesh->PrecachePSOs();
+		WarmupMesh->DestroyComponent();
+	}
+
+	if (ImpostorMesh && MarkPrewarmed(ImpostorMesh, GhostMaterial))
+	{
+		UStaticMeshComponent* WarmupMesh = NewObject<UStaticMeshComponent>(this);
+		WarmupMesh->SetStaticMesh(ImpostorMesh);
+		WarmupMesh->SetMaterial(0, GhostMaterial);
+		WarmupMesh->PrecachePSOs();
+		WarmupMesh->DestroyComponent();
+	}
+}
+
+void UTeleportationWorldSubsystem::PrewarmGhostMaterials(UMaterialInterface* Parent, int32 Count)
+{
+	if (!Parent) return;
+
+	int32 NumFree = 0;
+	for (const UMaterialInstanceDynamic* Material : FreeGhostMaterials)
+	{
+		if (Material->Parent == Parent)
+		{
+			NumFree++;
+		}
+	}
+
+	for (; NumFree < Count; NumFree++)
+	{
+		FreeGhostMaterials.Add(UMaterialInstanceDynamic::Create(Parent, this));
+	}
+}
+
+UMaterialInstanceDynamic* UTeleportationWorldSubsystem::AcquireGhostMaterial(UMaterialInterface* Parent)
+{
+	if (!Parent) return nullptr;
+
+	FTeleportHitchScope HitchScope(ETeleportHitchSection::GhostMaterial);
+
+	const int32 FreeIndex = FreeGhostMaterials.IndexOfByPredicate(
+		[Parent](const UMaterialInstanceDynamic* Material) { return Material->Parent == Parent; });
+
+	UMaterialInstanceDynamic* Material = nullptr;
+	if (FreeIndex != INDEX_NONE)
+	{
+		Material = FreeGhostMaterials[FreeIndex];
+		FreeGhostMaterials.RemoveAtSwap(FreeIndex);
+	}
+	else
+	{
+		Material = UMaterialInstanceDynamic::Create(Parent, this);
+	}
+
+	InUseGhostMaterials.Add(Material);
+	return Material;
+}
+
+void UTeleportationWorldSubsystem::ReleaseGhostMaterial(UMaterialInstanceDynamic* Material)
+{
+	if (!Material || InUseGhostMaterials.RemoveSwap(Material) == 0) return;
+
+	Material->ClearParameterValues();
+	FreeGhostMaterials.Add(Material);
+}
+
+ATeleportationPieceManager* UTeleportationWorldSubsystem::GetOrSpawnPieceManager(TSubclassOf<ATeleportationPieceManager> ManagerClass)
+{
+	if (IsValid(PieceManager)) return PieceManager;
+
+	UWorld* World = GetWorld();
+	TActorIterator<ATeleportationPieceManager> It(World);
+	if (It)
+	{
+		PieceManager = *It;
+		return PieceManager;
+	}
+
+	if (World->GetNetMode() == NM_Client) return nullptr;
+
+	PieceManager = World->SpawnActor<ATeleportationPieceManager>(
+		ManagerClass ? ManagerClass.Get() : ATeleportationPieceManager::StaticClass());
+	return PieceManager;
+}
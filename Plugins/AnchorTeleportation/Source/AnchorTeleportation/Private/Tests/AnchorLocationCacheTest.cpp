@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AnchorLocationCache.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace AnchorLocationCacheTest
+{
+	// Odd count so the last block has padding lanes
+	constexpr int32 NumAnchors = 37;
+
+	void BuildCache(FRandomStream& Random, FAnchorLocationCache& Cache, TArray<FVector>& OutLocations)
+	{
+		Cache.Reset();
+		OutLocations.Reset();
+		for (int32 Index = 0; Index < NumAnchors; Index++)
+		{
+			const FVector Location(Random.FRandRange(-50000.f, 50000.f), Random.FRandRange(-50000.f, 50000.f), Random.FRandRange(-2000.f, 2000.f));
+			OutLocations.Add(Location);
+			Cache.Add(nullptr, Location, Index);
+		}
+		Cache.Finalize();
+	}
+
+	float DistSquared(const FVector& A, const FVector& B)
+	{
+		// Same float precision as the cache
+		return FVector3f::DistSquared(FVector3f(A), FVector3f(B));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnchorLocationCacheFindNearestTest, "AnchorTeleportation.LocationCache.FindNearest",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAnchorLocationCacheFindNearestTest::RunTest(const FString& Parameters)
+{
+	using namespace AnchorLocationCacheTest;
+
+	FRandomStream Random(1234);
+	FAnchorLocationCache Cache;
+	TArray<FVector> Locations;
+	BuildCache(Random, Cache, Locations);
+
+	TArray<FVector> Points;
+	for (int32 Query = 0; Query < 200; Query++)
+	{
+		Points.Add(FVector(Random.FRandRange(-60000.f, 60000.f), Random.FRandRange(-60000.f, 60000.f), Random.FRandRange(-3000.f, 3000.f)));
+	}
+	// Further from every anchor than the padding lanes are from the origin
+	Points.Add(FVector(-1.0e15));
+
+	TArray<int32> BatchIndices;
+	BatchIndices.SetNumUninitialized(Points.Num());
+	Cache.FindNearestBatch(Points, BatchIndices);
+
+	for (int32 Query = 0; Query < Points.Num(); Query++)
+	{
+		const FVector& Point = Points[Query];
+
+		// Scalar reference, compared by distance since ties may pick either index
+		float ExpectedDistSquared = MAX_flt;
+		for (const FVector& Location : Locations)
+		{
+			ExpectedDistSquared = FMath::Min(ExpectedDistSquared, DistSquared(Point, Location));
+		}
+
+		float DistSquaredOut;
+		const int32 Nearest = Cache.FindNearest(Point, DistSquaredOut);
+		if (!TestTrue(TEXT("FindNearest returns a real anchor"), Nearest >= 0 && Nearest < Cache.Num())) return false;
+		TestEqual(TEXT("FindNearest matches the scalar reference"), DistSquared(Point, Locations[Nearest]), ExpectedDistSquared, ExpectedDistSquared * 1.0e-5f);
+
+		if (!TestTrue(TEXT("FindNearestBatch returns a real anchor"), BatchIndices[Query] >= 0 && BatchIndices[Query] < Cache.Num())) return false;
+		TestEqual(TEXT("FindNearestBatch matches the scalar reference"), DistSquared(Point, Locations[BatchIndices[Query]]), ExpectedDistSquared, ExpectedDistSquared * 1.0e-5f);
+	}
+
+	FAnchorLocationCache Empty;
+	float EmptyDistSquared;
+	TestEqual(TEXT("Empty cache finds nothing"), Empty.FindNearest(FVector::ZeroVector, EmptyDistSquared), INDEX_NONE);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnchorLocationCacheFindWithinRadiusTest, "AnchorTeleportation.LocationCache.FindWithinRadius",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAnchorLocationCacheFindWithinRadiusTest::RunTest(const FString& Parameters)
+{
+	using namespace AnchorLocationCacheTest;
+
+	FRandomStream Random(5678);
+	FAnchorLocationCache Cache;
+	TArray<FVector> Locations;
+	BuildCache(Random, Cache, Locations);
+
+	TArray<int32> Found;
+	for (int32 Query = 0; Query < 200; Query++)
+	{
+		const FVector Point(Random.FRandRange(-60000.f, 60000.f), Random.FRandRange(-60000.f, 60000.f), 0.f);
+		const float Radius = Random.FRandRange(0.f, 40000.f);
+
+		TArray<int32> Expected;
+		for (int32 Index = 0; Index < Locations.Num(); Index++)
+		{
+			if (DistSquared(Point, Locations[Index]) <= Radius * Radius)
+			{
+				Expected.Add(Index);
+			}
+		}
+
+		Cache.FindWithinRadius(Point, Radius, Found);
+		Found.Sort();
+		TestTrue(TEXT("FindWithinRadius matches the scalar reference"), Found == Expected);
+	}
+
+	// Radius squared overflows to infinity, padding lanes must still be skipped
+	Cache.FindWithinRadius(FVector::ZeroVector, MAX_flt, Found);
+	TestEqual(TEXT("Unbounded radius returns every anchor once"), Found.Num(), Cache.Num());
+	for (const int32 Index : Found)
+	{
+		TestTrue(TEXT("Unbounded radius returns no padding lanes"), Index < Cache.Num());
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnchorLocationCacheBenchmarkTest, "AnchorTeleportation.LocationCache.Benchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAnchorLocationCacheBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace AnchorLocationCacheTest;
+
+	constexpr int32 NumBenchAnchors = 4096;
+	constexpr int32 NumQueries = 1024;
+
+	// The loop the cache replaced walked anchor pointers and read each location through them
+	FRandomStream Random(4242);
+	FAnchorLocationCache Cache;
+	TArray<TUniquePtr<FVector>> AnchorLocations;
+	for (int32 Index = 0; Index < NumBenchAnchors; Index++)
+	{
+		const FVector Location(Random.FRandRange(-50000.f, 50000.f), Random.FRandRange(-50000.f, 50000.f), Random.FRandRange(-2000.f, 2000.f));
+		AnchorLocations.Add(MakeUnique<FVector>(Location));
+		Cache.Add(nullptr, Location, Index);
+	}
+	Cache.Finalize();
+
+	TArray<FVector> Points;
+	for (int32 Query = 0; Query < NumQueries; Query++)
+	{
+		Points.Add(FVector(Random.FRandRange(-60000.f, 60000.f), Random.FRandRange(-60000.f, 60000.f), 0.f));
+	}
+
+	TArray<int32> ScalarIndices;
+	const uint64 ScalarStart = FPlatformTime::Cycles64();
+	for (const FVector& Point : Points)
+	{
+		int32 Nearest = INDEX_NONE;
+		double NearestDistSquared = MAX_dbl;
+		for (int32 Index = 0; Index < AnchorLocations.Num(); Index++)
+		{
+			const double Dist = FVector::DistSquared(Point, *AnchorLocations[Index]);
+			if (Dist < NearestDistSquared)
+			{
+				NearestDistSquared = Dist;
+				Nearest = Index;
+			}
+		}
+		ScalarIndices.Add(Nearest);
+	}
+	const uint64 ScalarCycles = FPlatformTime::Cycles64() - ScalarStart;
+
+	TArray<int32> NearestIndices;
+	const uint64 NearestStart = FPlatformTime::Cycles64();
+	for (const FVector& Point : Points)
+	{
+		float DistSquaredOut;
+		NearestIndices.Add(Cache.FindNearest(Point, DistSquaredOut));
+	}
+	const uint64 NearestCycles = FPlatformTime::Cycles64() - NearestStart;
+
+	TArray<int32> BatchIndices;
+	BatchIndices.SetNumUninitialized(Points.Num());
+	const uint64 BatchStart = FPlatformTime::Cycles64();
+	Cache.FindNearestBatch(Points, BatchIndices);
+	const uint64 BatchCycles = FPlatformTime::Cycles64() - BatchStart;
+
+	// Keeps the timed loops honest, the results have to agree with the scalar reference
+	int32 NumDisagreeing = 0;
+	for (int32 Query = 0; Query < NumQueries; Query++)
+	{
+		const float Expected = DistSquared(Points[Query], *AnchorLocations[ScalarIndices[Query]]);
+		NumDisagreeing += FMath::IsNearlyEqual(DistSquared(Points[Query], *AnchorLocations[NearestIndices[Query]]), Expected, Expected * 1.0e-5f) ? 0 : 1;
+		NumDisagreeing += FMath::IsNearlyEqual(DistSquared(Points[Query], *AnchorLocations[BatchIndices[Query]]), Expected, Expected * 1.0e-5f) ? 0 : 1;
+	}
+	TestEqual(TEXT("Cache queries agree with the pointer loop"), NumDisagreeing, 0);
+
+	// Not asserted, machine dependent
+	AddInfo(FString::Printf(TEXT("%d anchors: pointer loop %.2f us, FindNearest %.2f us, FindNearestBatch %.2f us per query"), NumBenchAnchors,
+		FPlatformTime::ToMilliseconds64(ScalarCycles) * 1000.0 / NumQueries, FPlatformTime::ToMilliseconds64(NearestCycles) * 1000.0 / NumQueries,
+		FPlatformTime::ToMilliseconds64(BatchCycles) * 1000.0 / NumQueries));
+
+	return true;
+}
+
+#endif
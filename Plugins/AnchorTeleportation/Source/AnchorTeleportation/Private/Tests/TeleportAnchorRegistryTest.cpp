@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportAnchorRegistry.h"
+#include "HAL/Thread.h"
+#include "Misc/AutomationTest.h"
+#include <atomic>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace TeleportAnchorRegistryTest
+{
+	constexpr int32 NumReaders = 4;
+	constexpr int32 NumPublishes = 20000;
+
+	// Tables carry their generation twice, a reader that sees a torn or freed table sees the two disagree
+	TSharedRef<const FTeleportAnchorTable> MakeTable(int32 Generation)
+	{
+		TSharedRef<FTeleportAnchorTable> Table = MakeShared<FTeleportAnchorTable>();
+		Table->GroupStarts = { Generation, Generation };
+		return Table;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTeleportAnchorRegistryStressTest, "AnchorTeleportation.AnchorRegistry.Stress",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTeleportAnchorRegistryStressTest::RunTest(const FString& Parameters)
+{
+	using namespace TeleportAnchorRegistryTest;
+
+	FTeleportAnchorRegistry Registry;
+	Registry.Publish(MakeTable(0));
+
+	std::atomic<bool> bStop = false;
+	std::atomic<int32> NumBadSnapshots = 0;
+	std::atomic<int32> NumBackwardSnapshots = 0;
+	std::atomic<int64> NumReads = 0;
+	std::atomic<int32> MaxRetiredSeen = 0;
+
+	// Readers never pause, so there is always someone inside Read while the writer publishes
+	TArray<TUniquePtr<UE::FThread>> Threads;
+	for (int32 ReaderIndex = 0; ReaderIndex < NumReaders; ReaderIndex++)
+	{
+		Threads.Add(MakeUnique<UE::FThread>(TEXT("TeleportRegistryReader"), [&]()
+		{
+			int32 LastGeneration = 0;
+			int64 Reads = 0;
+			while (!bStop.load())
+			{
+				const TSharedRef<const FTeleportAnchorTable> Snapshot = Registry.Read();
+				if (Snapshot->GroupStarts.Num() != 2 || Snapshot->GroupStarts[0] != Snapshot->GroupStarts[1])
+				{
+					NumBadSnapshots++;
+					continue;
+				}
+				if (Snapshot->GroupStarts[0] < LastGeneration)
+				{
+					NumBackwardSnapshots++;
+				}
+				LastGeneration = Snapshot->GroupStarts[0];
+				Reads++;
+			}
+			NumReads += Reads;
+		}));
+	}
+
+	// The game thread reclaims once per tick, this one does it as often as it can
+	Threads.Add(MakeUnique<UE::FThread>(TEXT("TeleportRegistryReclaimer"), [&]()
+	{
+		while (!bStop.load())
+		{
+			Registry.Reclaim();
+		}
+	}));
+
+	for (int32 Generation = 1; Generation <= NumPublishes; Generation++)
+	{
+		Registry.Publish(MakeTable(Generation));
+
+		const int32 NumRetired = Registry.NumRetired();
+		if (NumRetired > MaxRetiredSeen.load())
+		{
+			MaxRetiredSeen = NumRetired;
+		}
+	}
+
+	bStop = true;
+	for (TUniquePtr<UE::FThread>& Thread : Threads)
+	{
+		Thread->Join();
+	}
+
+	TestEqual(TEXT("Every snapshot read was intact"), NumBadSnapshots.load(), 0);
+	TestEqual(TEXT("No reader saw an older snapshot after a newer one"), NumBackwardSnapshots.load(), 0);
+	TestTrue(TEXT("Readers ran during the publishes"), NumReads.load() > 0);
+	TestTrue(TEXT("Retired holders stay bounded under constant reads"), MaxRetiredSeen.load() <= FTeleportAnchorRegistry::MaxRetired);
+	TestEqual(TEXT("Latest snapshot is current"), Registry.Read()->GroupStarts[0], NumPublishes);
+
+	// With no readers left two passes free everything, one to drain and one for what the flip moved over
+	Registry.Reclaim();
+	Registry.Reclaim();
+	TestEqual(TEXT("Everything is reclaimed once reads stop"), Registry.NumRetired(), 0);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportationSubsystem.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/NetworkGuid.h"
+#include "UObject/CoreNet.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace TeleportAnchorReplicationTest
+{
+	constexpr int32 NumGroups = 10000; // Pairs, 20k anchors
+	constexpr int32 GridSize = 100;
+	constexpr float GroupSpacing = 2000.f;
+	constexpr float InterestRadius = 10000.f;
+
+	AActor* SpawnAt(UWorld* World, UClass* Class, const FVector& Location)
+	{
+		AActor* Actor = World->SpawnActor(Class);
+		USceneComponent* Root = NewObject<USceneComponent>(Actor, TEXT("Root"));
+		Actor->SetRootComponent(Root);
+		Root->RegisterComponent();
+		Actor->SetActorLocation(Location);
+		return Actor;
+	}
+
+	// What the owning client is sent on join and keeps afterwards. Anchors go out as their NetGUID, as they do once the
+	// client acknowledged them, so the first join also pays each anchor's path once on top of this
+	void Measure(const UTeleportationSubsystem* Component, int64& OutBytes, SIZE_T& OutClientBytes)
+	{
+		OutBytes = 0;
+		OutClientBytes = Component->AnchorPairs.Items.GetAllocatedSize();
+		for (const FReplicatedAnchorList& Item : Component->AnchorPairs.Items)
+		{
+			FNetBitWriter Writer(nullptr, 0);
+			FName AnchorID = Item.AnchorID;
+			UPackageMap::StaticSerializeName(Writer, AnchorID);
+
+			const TConstArrayView<AAnchor*> Anchors = Item.GetAnchors();
+			uint32 NumAnchors = Anchors.Num();
+			Writer.SerializeIntPacked(NumAnchors);
+			for (int32 Index = 0; Index < Anchors.Num(); Index++)
+			{
+				FNetworkGUID NetGUID = FNetworkGUID::CreateFromIndex(Anchors[Index]->GetUniqueID(), true);
+				Writer << NetGUID;
+			}
+
+			OutBytes += Writer.GetNumBytes();
+			OutClientBytes += Anchors.Num() * sizeof(AAnchor*);
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTeleportAnchorReplicationTest, "AnchorTeleportation.AnchorReplication.JoinSize",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTeleportAnchorReplicationTest::RunTest(const FString& Parameters)
+{
+	using namespace TeleportAnchorReplicationTest;
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	UTeleportationWorldSubsystem* WorldSubsystem = World->GetSubsystem<UTeleportationWorldSubsystem>();
+	if (!TestNotNull(TEXT("World subsystem exists"), WorldSubsystem))
+	{
+		World->DestroyWorld(false);
+		return false;
+	}
+
+	for (int32 Group = 0; Group < NumGroups; Group++)
+	{
+		const FVector GroupLocation((Group % GridSize) * GroupSpacing, (Group / GridSize) * GroupSpacing, 0.f);
+		for (int32 Side = 0; Side < 2; Side++)
+		{
+			AAnchor* Anchor = CastChecked<AAnchor>(SpawnAt(World, AAnchor::StaticClass(), GroupLocation + FVector(0.f, Side * 500.f, 0.f)));
+			Anchor->AnchorID = FName(TEXT("Anchor"), Group + 1);
+			WorldSubsystem->RegisterAnchor(Anchor);
+		}
+	}
+
+	// The player joins in the middle of the map
+	AActor* Pawn = SpawnAt(World, AActor::StaticClass(), FVector(GridSize * GroupSpacing * 0.5f, GridSize * GroupSpacing * 0.5f, 0.f));
+	UTeleportationSubsystem* Component = NewObject<UTeleportationSubsystem>(Pawn);
+	Component->RegisterComponent();
+
+	int64 AllBytes = 0;
+	SIZE_T AllClientBytes = 0;
+	Component->AnchorInterestRadius = 0.f;
+	Component->RefreshReplicatedAnchors(true);
+	TestEqual(TEXT("Radius 0 replicates every group"), Component->AnchorPairs.Items.Num(), NumGroups);
+	Measure(Component, AllBytes, AllClientBytes);
+
+	int64 InterestBytes = 0;
+	SIZE_T InterestClientBytes = 0;
+	Component->bRememberDiscoveredAnchors = false;
+	Component->AnchorInterestRadius = InterestRadius;
+	Component->RefreshReplicatedAnchors(true);
+	const int32 NumInterestGroups = Component->AnchorPairs.Items.Num();
+	TestTrue(TEXT("The interest radius only replicates groups near the player"), NumInterestGroups > 0 && NumInterestGroups < NumGroups / 10);
+	Measure(Component, InterestBytes, InterestClientBytes);
+
+	bool bAllNear = true;
+	for (const FReplicatedAnchorList& Item : Component->AnchorPairs.Items)
+	{
+		bool bNear = false;
+		for (const AAnchor* Anchor : Item.GetAnchors())
+		{
+			bNear |= FVector::Dist(Anchor->GetActorLocation(), Pawn->GetActorLocation()) <= InterestRadius;
+		}
+		bAllNear &= bNear;
+	}
+	TestTrue(TEXT("Every replicated group has an anchor inside the radius"), bAllNear);
+
+	AddInfo(FString::Printf(TEXT("%d anchors, every group: %d groups, %lld join bytes, %llu client bytes"),
+		NumGroups * 2, NumGroups, AllBytes, static_cast<uint64>(AllClientBytes)));
+	AddInfo(FString::Printf(TEXT("%d anchors, radius %.0f: %d groups, %lld join bytes, %llu client bytes"),
+		NumGroups * 2, InterestRadius, NumInterestGroups, InterestBytes, static_cast<uint64>(InterestClientBytes)));
+
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportGatingPolicy.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTeleportGatingPolicyTest, "AnchorTeleportation.GatingPolicy.Matrix",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTeleportGatingPolicyTest::RunTest(const FString& Parameters)
+{
+	struct FPolicyCase
+	{
+		FName Name;
+		bool bSpendsCharges;
+		bool bHasCooldown;
+	};
+
+	const FPolicyCase Cases[] =
+	{
+		{ FTeleportGatingPolicyRegistry::Cooldown, false, true },
+		{ FTeleportGatingPolicyRegistry::Charges, true, false },
+		{ FTeleportGatingPolicyRegistry::ChargesAndCooldown, true, true },
+		{ FTeleportGatingPolicyRegistry::Unlimited, false, false },
+	};
+
+	constexpr float Cooldown = 5.f;
+	constexpr double FirstTeleport = 100.0;
+
+	for (const FPolicyCase& Case : Cases)
+	{
+		const FString Name = Case.Name.ToString();
+		TUniquePtr<ITeleportGatingPolicy> Policy = FTeleportGatingPolicyRegistry::Create(Case.Name);
+		if (!TestNotNull(*FString::Printf(TEXT("%s is registered"), *Name), Policy.Get())) continue;
+
+		// No charges, never teleported
+		{
+			uint32 Charges = 0;
+			FTeleportGateContext Context{ FirstTeleport, Cooldown, Charges };
+			TestEqual(*FString::Printf(TEXT("%s CanTeleport without charges"), *Name), Policy->CanTeleport(Context), !Case.bSpendsCharges);
+		}
+
+		// A failed Commit must not start the cooldown, so this is checked on a separate instance
+		{
+			TUniquePtr<ITeleportGatingPolicy> Broke = FTeleportGatingPolicyRegistry::Create(Case.Name);
+			uint32 Charges = 0;
+			FTeleportGateContext Context{ FirstTeleport, Cooldown, Charges };
+			TestEqual(*FString::Printf(TEXT("%s Commit without charges"), *Name), Broke->Commit(Context), !Case.bSpendsCharges);
+			TestEqual(*FString::Printf(TEXT("%s charges never go below zero"), *Name), Charges, 0u);
+		}
+
+		// One charge, never teleported
+		{
+			uint32 Charges = 1;
+			FTeleportGateContext Context{ FirstTeleport, Cooldown, Charges };
+			TestTrue(*FString::Printf(TEXT("%s CanTeleport with a charge"), *Name), Policy->CanTeleport(Context));
+			TestTrue(*FString::Printf(TEXT("%s Commit with a charge"), *Name), Policy->Commit(Context));
+			TestEqual(*FString::Printf(TEXT("%s Commit spends a charge"), *Name), Charges, Case.bSpendsCharges ? 0u : 1u);
+		}
+
+		// Inside the cooldown of that teleport
+		{
+			uint32 Charges = 1;
+			FTeleportGateContext Context{ FirstTeleport + Cooldown * 0.5, Cooldown, Charges };
+			TestEqual(*FString::Printf(TEXT("%s CanTeleport inside the cooldown"), *Name), Policy->CanTeleport(Context), !Case.bHasCooldown);
+			TestEqual(*FString::Printf(TEXT("%s Commit inside the cooldown"), *Name), Policy->Commit(Context), !Case.bHasCooldown);
+			TestEqual(*FString::Printf(TEXT("%s failed Commit keeps the charge"), *Name), Charges,
+				Case.bSpendsCharges && !Case.bHasCooldown ? 0u : 1u);
+		}
+
+		// Once the cooldown of the first teleport is over, a rejected Commit above must not have restarted it
+		{
+			uint32 Charges = 1;
+			FTeleportGateContext Context{ FirstTeleport + Cooldown, Cooldown, Charges };
+			if (Case.bHasCooldown)
+			{
+				TestTrue(*FString::Printf(TEXT("%s CanTeleport after the cooldown"), *Name), Policy->CanTeleport(Context));
+			}
+
+			Charges = 0;
+			TestEqual(*FString::Printf(TEXT("%s CanTeleport after the cooldown without charges"), *Name),
+				Policy->CanTeleport(Context), !Case.bSpendsCharges);
+		}
+	}
+
+	TestNull(TEXT("Unknown policy names create nothing"), FTeleportGatingPolicyRegistry::Create(TEXT("NoSuchPolicy")).Get());
+
+	// Not asserted, machine dependent, but printed so the policies can be compared in the automation log. Time moves past
+	// the cooldown every step and charges never run out, so each step takes the full CanTeleport and Commit path
+	constexpr int32 NumChecks = 100000;
+	for (const FPolicyCase& Case : Cases)
+	{
+		TUniquePtr<ITeleportGatingPolicy> Policy = FTeleportGatingPolicyRegistry::Create(Case.Name);
+		if (!Policy) continue;
+
+		uint32 Charges = NumChecks;
+		int32 NumPassed = 0;
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (int32 Check = 0; Check < NumChecks; Check++)
+		{
+			FTeleportGateContext Context{ FirstTeleport + Check * Cooldown, Cooldown, Charges };
+			NumPassed += Policy->CanTeleport(Context) && Policy->Commit(Context) ? 1 : 0;
+		}
+		const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+
+		TestEqual(*FString::Printf(TEXT("%s lets every timed teleport through"), *Case.Name.ToString()), NumPassed, NumChecks);
+		AddInfo(FString::Printf(TEXT("%s: %.1f ns per CanTeleport and Commit"), *Case.Name.ToString(), Seconds * 1.0e9 / NumChecks));
+	}
+
+	return true;
+}
+
+#endif
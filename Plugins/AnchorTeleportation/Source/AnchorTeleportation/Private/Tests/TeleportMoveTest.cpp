@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportationSubsystem.h"
+#include "Components/BoxComponent.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace TeleportMoveTest
+{
+	constexpr int32 NumAttached = 64;
+	constexpr int32 NumMoves = 200;
+
+	// Root plus a chain of overlapping boxes, the worst case for a component-by-component update
+	AActor* SpawnHeavyActor(UWorld* World, TArray<UBoxComponent*>& OutBoxes)
+	{
+		AActor* Actor = World->SpawnActor<AActor>();
+		USceneComponent* Root = NewObject<USceneComponent>(Actor, TEXT("Root"));
+		Actor->SetRootComponent(Root);
+		Root->RegisterComponent();
+
+		USceneComponent* Parent = Root;
+		for (int32 Index = 0; Index < NumAttached; Index++)
+		{
+			UBoxComponent* Box = NewObject<UBoxComponent>(Actor);
+			Box->SetGenerateOverlapEvents(true);
+			Box->SetupAttachment(Parent);
+			Box->SetRelativeLocation(FVector(10.f, 0.f, 0.f));
+			Box->RegisterComponent();
+			OutBoxes.Add(Box);
+			Parent = Box;
+		}
+		return Actor;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTeleportMoveTest, "AnchorTeleportation.TeleportMove",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTeleportMoveTest::RunTest(const FString& Parameters)
+{
+	using namespace TeleportMoveTest;
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	TArray<UBoxComponent*> Boxes;
+	AActor* Actor = SpawnHeavyActor(World, Boxes);
+
+	const FVector Destination(5000.f, -2000.f, 300.f);
+	UTeleportationSubsystem::TeleportMove(Actor, Destination);
+
+	TestEqual(TEXT("Root lands on the destination"), Actor->GetActorLocation(), Destination);
+	bool bChildrenFollowed = true;
+	for (int32 Index = 0; Index < Boxes.Num(); Index++)
+	{
+		// Each box sits 10 units further along the chain than its parent
+		bChildrenFollowed &= Boxes[Index]->GetComponentLocation().Equals(Destination + FVector(10.f * (Index + 1), 0.f, 0.f));
+		bChildrenFollowed &= Boxes[Index]->Bounds.Origin.Equals(Boxes[Index]->GetComponentLocation());
+	}
+	TestTrue(TEXT("Attached components and their bounds follow in the same update"), bChildrenFollowed);
+
+	// Null actors are ignored rather than crashing
+	UTeleportationSubsystem::TeleportMove(nullptr, Destination);
+
+	// Not asserted, machine dependent, but printed so the two paths can be compared in the automation log
+	const double TeleportMoveStart = FPlatformTime::Seconds();
+	for (int32 Move = 0; Move < NumMoves; Move++)
+	{
+		UTeleportationSubsystem::TeleportMove(Actor, FVector(Move % 2 ? 1000.f : -1000.f, 0.f, 0.f));
+	}
+	const double TeleportMoveSeconds = FPlatformTime::Seconds() - TeleportMoveStart;
+
+	const double SetLocationStart = FPlatformTime::Seconds();
+	for (int32 Move = 0; Move < NumMoves; Move++)
+	{
+		Actor->SetActorLocation(FVector(Move % 2 ? 1000.f : -1000.f, 0.f, 0.f));
+	}
+	const double SetLocationSeconds = FPlatformTime::Seconds() - SetLocationStart;
+
+	AddInfo(FString::Printf(TEXT("%d attached components: TeleportMove %.1f us, SetActorLocation %.1f us per teleport"), NumAttached,
+		TeleportMoveSeconds * 1.0e6 / NumMoves, SetLocationSeconds * 1.0e6 / NumMoves));
+
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportMovementHistory.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTeleportMovementHistoryTest, "AnchorTeleportation.MovementHistory",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTeleportMovementHistoryTest::RunTest(const FString& Parameters)
+{
+	FTeleportMovementHistory History;
+	TestFalse(TEXT("Empty history was never near anything"), History.WasNear(FVector::ZeroVector, 100.f, 0.f, 1.f));
+	TestTrue(TEXT("Empty history has no latest time"), History.LatestTime() < 0.f);
+
+	// One sample per 0.1 s walking along X, 100 units per sample
+	for (int32 Index = 0; Index < 10; Index++)
+	{
+		History.Add(FVector(Index * 100.f, 0.f, 0.f), Index * 0.1f);
+	}
+	TestEqual(TEXT("Latest time is the last sample"), History.LatestTime(), 0.9f);
+
+	TestTrue(TEXT("Recent sample within radius"), History.WasNear(FVector(850.f, 0.f, 0.f), 60.f, 0.9f, 0.5f));
+	TestFalse(TEXT("Sample outside the window is ignored"), History.WasNear(FVector::ZeroVector, 60.f, 0.9f, 0.5f));
+	TestTrue(TEXT("Sample at the edge of the window counts"), History.WasNear(FVector(400.f, 0.f, 0.f), 1.f, 0.9f, 0.5f));
+	TestFalse(TEXT("Samples are tested against the radius"), History.WasNear(FVector(850.f, 200.f, 0.f), 60.f, 0.9f, 0.5f));
+
+	// Wrap the ring, the first samples are overwritten
+	for (int32 Index = 10; Index < FTeleportMovementHistory::Capacity + 10; Index++)
+	{
+		History.Add(FVector(Index * 100.f, 0.f, 0.f), Index * 0.1f);
+	}
+	const float Now = (FTeleportMovementHistory::Capacity + 9) * 0.1f;
+	TestEqual(TEXT("Count stops at capacity"), History.Count, FTeleportMovementHistory::Capacity);
+	TestEqual(TEXT("Latest time survives the wrap"), History.LatestTime(), Now, 1.0e-4f);
+	TestFalse(TEXT("Overwritten sample is gone"), History.WasNear(FVector(500.f, 0.f, 0.f), 1.f, Now, 100.f));
+	TestTrue(TEXT("Oldest kept sample is still there"), History.WasNear(FVector(1000.f, 0.f, 0.f), 1.f, Now, 100.f));
+
+	// Full ring and a window covering all of it, the worst case for the per-request check. The target is under 1 us
+	constexpr int32 NumChecks = 100000;
+	int32 NumNear = 0;
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	for (int32 Check = 0; Check < NumChecks; Check++)
+	{
+		NumNear += History.WasNear(FVector(-1000.f - Check, 0.f, 0.f), 1.f, Now, 100.f) ? 1 : 0;
+	}
+	const double MicrosPerCheck = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) * 1000.0 / NumChecks;
+	TestEqual(TEXT("Timed checks are all misses, so every sample is visited"), NumNear, 0);
+	AddInfo(FString::Printf(TEXT("WasNear over %d samples: %.3f us per check"), FTeleportMovementHistory::Capacity, MicrosPerCheck));
+
+	return true;
+}
+
+#endif
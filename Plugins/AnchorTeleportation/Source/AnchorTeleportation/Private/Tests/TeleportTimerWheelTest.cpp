@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TeleportTimerWheel.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace TeleportTimerWheelTest
+{
+	constexpr double TickSeconds = 0.05;
+	constexpr int32 NumSlots = 512;
+	constexpr double Rotation = TickSeconds * NumSlots;
+
+	// Frame steps do not add up exactly in binary, allow a tick of drift on top of the tick rounding
+	constexpr double Tolerance = TickSeconds * 2.0 + UE_KINDA_SMALL_NUMBER;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTeleportTimerWheelTest, "AnchorTeleportation.TimerWheel",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTeleportTimerWheelTest::RunTest(const FString& Parameters)
+{
+	using namespace TeleportTimerWheelTest;
+
+	FTeleportTimerWheel Wheel(TickSeconds, NumSlots);
+	double Elapsed = 0.0;
+
+	// Spaced wider than a tick, so they must fire in the order they are due, across almost three rotations
+	constexpr int32 NumTimers = 300;
+	constexpr double Spacing = 0.237;
+	TArray<double> Delays;
+	TArray<double> FiredAt;
+	TArray<int32> FireCounts;
+	TArray<int32> FireOrder;
+	TArray<FTeleportTimerHandle> Handles;
+	for (int32 Id = 0; Id < NumTimers; Id++)
+	{
+		Delays.Add(Id * Spacing);
+		FiredAt.Add(-1.0);
+		FireCounts.Add(0);
+		Handles.Add(Wheel.Schedule(Delays[Id], FSimpleDelegate::CreateLambda([&, Id]()
+		{
+			FiredAt[Id] = Elapsed;
+			FireCounts[Id]++;
+			FireOrder.Add(Id);
+		})));
+	}
+
+	// Delays that land on the current slot again after one and two full turns
+	int32 RotationFires[2] = { 0, 0 };
+	double RotationFiredAt[2] = { -1.0, -1.0 };
+	for (int32 Turns = 1; Turns <= 2; Turns++)
+	{
+		Wheel.Schedule(Rotation * Turns, FSimpleDelegate::CreateLambda([&, Turns]()
+		{
+			RotationFires[Turns - 1]++;
+			RotationFiredAt[Turns - 1] = Elapsed;
+		}));
+	}
+
+	// Every third timer is cancelled before it is due
+	int32 NumCancelled = 0;
+	for (int32 Id = 1; Id < NumTimers; Id += 3)
+	{
+		Wheel.Cancel(Handles[Id]);
+		TestFalse(TEXT("Cancel invalidates the handle"), Handles[Id].IsValid());
+		NumCancelled++;
+	}
+	TestEqual(TEXT("Cancelled entries leave the wheel right away"), Wheel.Num(), NumTimers - NumCancelled + 2);
+
+	// A callback that schedules another timer from inside Advance
+	int32 NumChained = 0;
+	Wheel.Schedule(1.0, FSimpleDelegate::CreateLambda([&]()
+	{
+		Wheel.Schedule(Rotation, FSimpleDelegate::CreateLambda([&]() { NumChained++; }));
+	}));
+
+	int32 NumFired = 0;
+	const double End = Delays.Last() + Rotation + 2.0;
+	while (Elapsed < End)
+	{
+		Elapsed += TickSeconds;
+		NumFired += Wheel.Advance(TickSeconds);
+	}
+
+	bool bOnTime = true;
+	bool bFiredOnce = true;
+	for (int32 Id = 0; Id < NumTimers; Id++)
+	{
+		const bool bCancelled = Id % 3 == 1;
+		bFiredOnce &= FireCounts[Id] == (bCancelled ? 0 : 1);
+		if (!bCancelled)
+		{
+			bOnTime &= FiredAt[Id] >= Delays[Id] - UE_KINDA_SMALL_NUMBER && FiredAt[Id] <= Delays[Id] + Tolerance;
+		}
+	}
+	TestTrue(TEXT("Live timers fire once and cancelled ones never"), bFiredOnce);
+	TestTrue(TEXT("Timers fire on the first tick at or after their delay, whatever the round"), bOnTime);
+
+	bool bInOrder = true;
+	for (int32 Index = 1; Index < FireOrder.Num(); Index++)
+	{
+		bInOrder &= FireOrder[Index - 1] < FireOrder[Index];
+	}
+	TestTrue(TEXT("Timers fire in the order they are due"), bInOrder);
+
+	for (int32 Turns = 1; Turns <= 2; Turns++)
+	{
+		TestEqual(*FString::Printf(TEXT("Delay of %d full turns fires once"), Turns), RotationFires[Turns - 1], 1);
+		TestTrue(*FString::Printf(TEXT("Delay of %d full turns waits for all of them"), Turns),
+			RotationFiredAt[Turns - 1] >= Rotation * Turns - UE_KINDA_SMALL_NUMBER && RotationFiredAt[Turns - 1] <= Rotation * Turns + Tolerance);
+	}
+
+	TestEqual(TEXT("Timers scheduled from a callback fire"), NumChained, 1);
+	TestEqual(TEXT("Advance counts every fired timer"), NumFired, NumTimers - NumCancelled + 2 + 2);
+	TestEqual(TEXT("Wheel is empty once everything fired"), Wheel.Num(), 0);
+
+	// A handle kept past its timer must not cancel a new entry that reused the slot
+	bool bReusedFired = false;
+	FTeleportTimerHandle Stale = Wheel.Schedule(TickSeconds, FSimpleDelegate());
+	Wheel.Advance(TickSeconds * 2.0);
+	Wheel.Schedule(TickSeconds, FSimpleDelegate::CreateLambda([&]() { bReusedFired = true; }));
+	Wheel.Cancel(Stale);
+	Wheel.Advance(TickSeconds * 2.0);
+	TestTrue(TEXT("Stale handles do not cancel newer timers"), bReusedFired);
+
+	return true;
+}
+
+#endif
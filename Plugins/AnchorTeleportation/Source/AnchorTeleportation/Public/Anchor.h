@@ -16,10 +16,59 @@ public:
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-public:    
+public:
+#if WITH_EDITOR
+	// Keep the editor's anchor validator in step with loaded, edited and deleted anchors
+	virtual void PostRegisterAllComponents() override;
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+	virtual void Destroyed() override;
+
+	// Lets the validator group anchors in unloaded World Partition cells
+	virtual void GetActorDescProperties(FPropertyPairsMap& PropertyPairsMap) const override;
+
+	virtual EDataValidationResult IsDataValid(class FDataValidationContext& Context) const override;
+
+	class FTeleportAnchorValidator* GetEditorValidator() const;
+#endif
+    
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation")
 	FName AnchorID;
+
+	// Server to travel to, as host:port. Required for remote anchors, a map alone would start a standalone game
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation|Remote")
+	FString DestinationAddress;
+
+	// Streamed in by clients near the anchor so the teleport only has to swap worlds
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation|Remote")
+	TSoftObjectPtr<UWorld> DestinationMap;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation|Remote")
+	FName DestinationAnchorID;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation|Remote")
+	float PreloadRadius = 1500.f;
+
+	// Arrivals let through per ArrivalWindow, players over it wait in a queue. 0 admits everyone at once
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation|Capacity")
+	int32 ArrivalCapacity = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation|Capacity")
+	float ArrivalWindow = 1.f;
+
+	// Send players to another anchor of the group with room left instead of queueing them here
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation|Capacity")
+	bool bRedirectToSiblings = true;
+
+	// Queued teleports give up after this long
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Teleportation|Capacity")
+	float MaxQueueTime = 15.f;
+
+	// Remote anchors send players to another server or map instead of a paired anchor in this world
+	bool IsRemote() const { return !DestinationAddress.IsEmpty() || !DestinationMap.IsNull(); }
+
+	FString GetTravelURL() const;
 	
 	void RegisterWithSubsystem();
 };
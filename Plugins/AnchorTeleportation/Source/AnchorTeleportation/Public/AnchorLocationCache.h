@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AAnchor;
+
+// Structure-of-arrays mirror of anchor positions, padded to whole SIMD lanes so queries never chase actor pointers
+struct ANCHORTELEPORTATION_API FAnchorLocationCache
+{
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+	TArray<int32> GroupIndex;
+	TArray<AAnchor*> Anchors;
+
+	void Reset();
+
+	void Add(AAnchor* Anchor, int32 InGroupIndex);
+
+	void Add(AAnchor* Anchor, const FVector& Location, int32 InGroupIndex);
+
+	// Pads the position buffers after the last Add, must be called before querying
+	void Finalize();
+
+	int32 Num() const { return Anchors.Num(); }
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return X.GetAllocatedSize() + Y.GetAllocatedSize() + Z.GetAllocatedSize() + GroupIndex.GetAllocatedSize() + Anchors.GetAllocatedSize();
+	}
+
+	int32 FindNearest(const FVector& Point, float& OutDistSquared) const;
+
+	void FindWithinRadius(const FVector& Point, float Radius, TArray<int32>& OutIndices) const;
+
+	// Nearest anchor for every query point, walks the buffers in blocks so they stay in cache across queries
+	void FindNearestBatch(TConstArrayView<FVector> Points, TArrayView<int32> OutIndices) const;
+};
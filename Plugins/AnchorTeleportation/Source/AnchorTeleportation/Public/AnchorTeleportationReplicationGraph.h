@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BasicReplicationGraph.h"
+#include "ReplicationGraph.h"
+#include "AnchorTeleportationReplicationGraph.generated.h"
+
+// Per-connection node that sends the teleport actors around a pending destination before the player lands there
+UCLASS()
+class ANCHORTELEPORTATION_API UReplicationGraphNode_TeleportDestination : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override { }
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override { return false; }
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+
+	// Returns how many candidates are around Destination
+	int32 SetDestination(const FVector& Destination, float Radius, double ExpireTime, const TArray<TObjectPtr<AActor>>& Candidates);
+
+	void ClearDestination();
+
+private:
+	FActorRepListRefView ReplicationActorList;
+
+	double ExpireTime = 0.0;
+};
+
+// Big pieces sit in the spatial grid as static actors, everything else follows the basic graph. Anchors do not
+// replicate, clients load them with the level. Opt-in through the net driver config, see README.md
+UCLASS(Transient, Config = Engine)
+class ANCHORTELEPORTATION_API UAnchorTeleportationReplicationGraph : public UBasicReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual void RemoveClientConnection(UNetConnection* NetConnection) override;
+
+	// Called by the teleport subsystem as soon as the destination is known. True when this graph is active and has
+	// actors to send ahead, the caller should then give them a moment before moving the player
+	static bool NotifyTeleportDestination(APlayerController* PlayerController, const FVector& Destination);
+
+	UPROPERTY(Config)
+	float GridCellSize = 10000.f;
+
+	UPROPERTY(Config)
+	float DestinationRadius = 5000.f;
+
+	UPROPERTY(Config)
+	float DestinationHoldTime = 2.f; // Seconds the destination stays relevant after the teleport
+
+private:
+	static bool IsTeleportActor(const AActor* Actor);
+
+	UPROPERTY()
+	TArray<TObjectPtr<AActor>> TeleportActors;
+
+	UPROPERTY()
+	TMap<TObjectPtr<UNetConnection>, TObjectPtr<UReplicationGraphNode_TeleportDestination>> DestinationNodes;
+};
@@ -7,6 +7,34 @@
 #include "GameFramework/Actor.h"
 #include "BigTeleportationPiece.generated.h"
 
+// Everything a client needs to rebuild the pieces of one break, piece positions come from the seed
+USTRUCT()
+struct FTeleportPieceBreak
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 BreakId = 0;
+
+	UPROPERTY()
+	int32 Seed = 0;
+
+	UPROPERTY()
+	FVector_NetQuantize ReferenceLocation;
+
+	UPROPERTY()
+	uint8 NumPieces = 0;
+
+	UPROPERTY()
+	uint32 CollectedMask = 0;
+
+	UPROPERTY()
+	double StartTime = 0.0; // Server world time of the break
+
+	UPROPERTY()
+	float DespawnTime = 0.f; // Server's tuned value, clients do not read their own teleport.tune.despawntime
+};
+
 UCLASS()
 class ANCHORTELEPORTATION_API ABigTeleportationPiece : public AActor
 {
@@ -28,7 +56,22 @@ public:
 	class UBoxComponent* Collider;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
-	TArray<TSubclassOf<AActor>> AllowedColliders;
+	TArray<TSoftClassPtr<AActor>> AllowedColliders; // Never loaded by us, an unloaded class cannot have live instances
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float HitThrottleInterval = 0.25f; // Minimum time between handled hits from the same actor
+
+	bool IsAllowedCollider(const AActor* OtherActor);
+
+	// Call after changing AllowedColliders at runtime
+	void ResetAllowedColliderCache();
+
+	// Verdict per concrete class, so each class walks AllowedColliders once
+	TMap<TObjectKey<UClass>, bool> AllowedClassCache;
+
+	TMap<TObjectKey<AActor>, double> LastHitTimes;
+
+	double LastHitPruneTime = 0.0;
 
 	UFUNCTION()
 	void BreakSource(APlayerController* InstigatorPlayer, FVector SpawnReferenceLocation);
@@ -36,20 +79,65 @@ public:
 	UFUNCTION(Server, Reliable)
 	void ServerBreakSource(APlayerController* InstigatorPlayer, FVector SpawnReferenceLocation);
 
+	bool FindSafeSpawnLocation(FRandomStream& RandomStream, FVector PlayerLocation, FVector& OutLocation);
+
+	// Server side, replicates one seeded break event instead of every piece
+	void StartBreak(APlayerController* InstigatorPlayer, FVector SpawnReferenceLocation);
+
+	// Runs identically on server and clients, pieces are local actors tagged with their break and index
+	void SpawnPiecesForBreak(const FTeleportPieceBreak& Break);
+
+	void MarkPieceCollected(int32 BreakId, int32 PieceIndex);
+
+	void ExpireBreak(int32 BreakId);
+
+	// Game state's replicated clock, break start times are compared against it on every machine
+	double GetServerTime() const;
+
+	UFUNCTION()
+	void OnRep_ActiveBreaks();
+
+	UPROPERTY(ReplicatedUsing = OnRep_ActiveBreaks)
+	TArray<FTeleportPieceBreak> ActiveBreaks;
+
+	TMap<int32, TArray<TWeakObjectPtr<ASmallTeleportationPieces>>> LocalPieces;
+
+	int32 NextBreakId = 1;
+
 	UFUNCTION()
-	bool FindSafeSpawnLocation(FVector PlayerLocation, FVector& OutLocation);
+	void DeactivateAndScheduleRespawn();
 
 	UFUNCTION()
-	void DestroyAndRespawnSource();
+	void RestoreSource();
+
+	UFUNCTION()
+	void OnRep_SourceActive();
+
+	// The source is hidden while broken instead of destroyed, so its break events keep replicating
+	UPROPERTY(ReplicatedUsing = OnRep_SourceActive)
+	bool bSourceActive = true;
 
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
-	TSubclassOf<ASmallTeleportationPieces> PieceClass; // The collectible piece
+	TSoftClassPtr<ASmallTeleportationPieces> PieceClass; // The collectible piece, streamed in after BeginPlay
+
+	TSharedPtr<struct FStreamableHandle> PieceClassHandle;
 
+	UClass* GetLoadedPieceClass();
+
+	// Pieces become entries in the world's ATeleportationPieceManager instead of actors
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
-	int32 MaxPieces = 3; // How many pieces spawn
+	bool bUsePieceManager = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation", meta = (EditCondition = "bUsePieceManager"))
+	TSubclassOf<class ATeleportationPieceManager> PieceManagerClass;
+
+	void AddPiecesToManager(FVector SpawnReferenceLocation);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation", meta = (ClampMin = "1", ClampMax = "32"))
+	int32 MaxPieces = 3; // How many pieces spawn, at most 32 so they fit the collected mask
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
 	float RespawnTime = 10.0f; // How long before respawning
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "TeleportTimerWheel.h"
 #include "SmallTeleportationPieces.generated.h"
 
 UCLASS()
@@ -16,9 +17,8 @@ public:
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 public:
-
-	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 	
 	UPROPERTY(VisibleAnywhere, Category = "Teleportation")
 	UStaticMeshComponent* MeshComponent;
@@ -26,14 +26,28 @@ public:
 	UPROPERTY(VisibleAnywhere, Category = "Teleportation")
 	class USphereComponent* Collider;
 
-	UPROPERTY(Replicated, BlueprintReadOnly, Category = "Teleportation")
+	// Local state, every machine spawns its own copy and collection reaches clients through the source's break event
+	UPROPERTY(BlueprintReadOnly, Category = "Teleportation")
 	bool bIsCollected = false;
 
-	UPROPERTY(Replicated, BlueprintReadOnly, Category = "Teleportation")
+	UPROPERTY(BlueprintReadOnly, Category = "Teleportation")
 	bool bCanBePickedUp = false;
 
 	int OverlapCheckAttempts = 0;
+
+	// Set when spawned from a seeded break, collecting reports back to the source
+	TWeakObjectPtr<class ABigTeleportationPiece> SourcePiece;
+
+	int32 BreakId = 0;
+
+	int32 PieceIndex = INDEX_NONE;
+
+	float SpawnAge = 0.f; // Seconds the break had already run when this copy spawned, late joiners only get what is left
 	
+	FTeleportTimerHandle DespawnTimer;
+
+	FTeleportTimerHandle PickupDelayTimer;
+
 	UFUNCTION()
 	void EnablePickup(); // Allows pickup after a delay
 	
@@ -43,6 +57,9 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
 	float DespawnTime = 15.0f;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float PickupDelay = 1.0f;
+
 	UFUNCTION()
 	void OnSphereOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, 
 		UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "TeleportationPieceManager.generated.h"
+
+class ATeleportationPieceManager;
+
+USTRUCT()
+struct FTeleportPieceState : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 PieceId = 0;
+
+	UPROPERTY()
+	FVector_NetQuantize Location;
+
+	// Server only
+	double PickupTime = 0.0;
+	double ExpireTime = 0.0;
+
+	void PostReplicatedAdd(const struct FTeleportPieceStateArray& InArraySerializer);
+	void PreReplicatedRemove(const struct FTeleportPieceStateArray& InArraySerializer);
+};
+
+USTRUCT()
+struct FTeleportPieceStateArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FTeleportPieceState> Items;
+
+	ATeleportationPieceManager* Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FTeleportPieceState, FTeleportPieceStateArray>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FTeleportPieceStateArray> : public TStructOpsTypeTraitsBase2<FTeleportPieceStateArray>
+{
+	enum { WithNetDeltaSerializer = true };
+};
+
+// Holds pieces as plain entries instead of actors: one instanced mesh, one grid check against players, one replicated array
+UCLASS(Blueprintable)
+class ANCHORTELEPORTATION_API ATeleportationPieceManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ATeleportationPieceManager();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+public:
+	virtual void Tick(float DeltaSeconds) override;
+
+	UPROPERTY(VisibleAnywhere, Category = "Teleportation")
+	class UInstancedStaticMeshComponent* InstancedMesh;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float PickupRadius = 60.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float PickupDelay = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float DespawnTime = 15.f;
+
+	UPROPERTY(Replicated)
+	FTeleportPieceStateArray Pieces;
+
+	void AddPiece(const FVector& Location);
+
+	void RemovePieceAt(int32 ItemIndex);
+
+	void AddInstance(const FTeleportPieceState& Piece);
+
+	void RemoveInstance(const FTeleportPieceState& Piece);
+
+	int32 NumPieces() const { return Pieces.Items.Num(); }
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	FIntPoint GetCell(const FVector& Location) const;
+
+	void RebuildGrid();
+
+	void CollectOverlappingPieces(double Now);
+
+	int32 NextPieceId = 1;
+
+	// Server side lookup from grid cell to item indices, rebuilt after the item array changes
+	TMap<FIntPoint, TArray<int32>> Grid;
+
+	bool bGridDirty = true;
+
+	// Instance index -> piece id, instances are removed with swap so this mirrors the component
+	TArray<int32> InstancePieceIds;
+
+	TMap<int32, int32> PieceIdToInstance;
+};
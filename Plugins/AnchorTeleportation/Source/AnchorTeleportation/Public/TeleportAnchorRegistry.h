@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TeleportAnchorTable.h"
+#include <atomic>
+
+// Read-copy-update holder for the anchor table. Writers publish whole snapshots, readers on any thread take a
+// reference to the current one without locking. Anchor pointers in a snapshot are only safe to dereference on the game thread.
+class ANCHORTELEPORTATION_API FTeleportAnchorRegistry
+{
+public:
+	FTeleportAnchorRegistry();
+	~FTeleportAnchorRegistry();
+
+	FTeleportAnchorRegistry(const FTeleportAnchorRegistry&) = delete;
+	FTeleportAnchorRegistry& operator=(const FTeleportAnchorRegistry&) = delete;
+
+	// Lock free, the snapshot stays valid for as long as the caller holds it
+	TSharedRef<const FTeleportAnchorTable> Read() const;
+
+	void Publish(TSharedRef<const FTeleportAnchorTable> Snapshot);
+
+	// Frees replaced snapshot holders once no reader can still be looking at them
+	void Reclaim();
+
+	// Holders waiting to be freed, for tests and stats
+	int32 NumRetired() const;
+
+	// Publish waits for in-flight readers instead of letting more holders pile up
+	static constexpr int32 MaxRetired = 8;
+
+private:
+	using FSnapshotHolder = TSharedRef<const FTeleportAnchorTable>;
+
+	void ReclaimLocked(bool bWait);
+
+	std::atomic<FSnapshotHolder*> Current;
+
+	// Readers count themselves under the parity of the epoch they started in, so readers that arrive after a flip
+	// never hold up the holders retired before it, even when reads never stop
+	std::atomic<uint32> Epoch{ 0 };
+	mutable std::atomic<int32> ActiveReaders[2] = { 0, 0 };
+
+	mutable FCriticalSection WriteLock;
+	TArray<FSnapshotHolder*> Retired;  // Replaced during the current epoch
+	TArray<FSnapshotHolder*> Draining; // Replaced before the last flip, freed once the old parity drops to zero
+};
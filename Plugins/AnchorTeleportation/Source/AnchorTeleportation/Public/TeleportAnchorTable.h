@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnchorLocationCache.h"
+
+class AAnchor;
+
+// Immutable anchor pairing shared by every teleport component in a world, rebuilt as a whole when anchors change.
+// Anchors are stored sorted by group so a group is the range [GroupStarts[G], GroupStarts[G + 1]) and a pair costs no allocation of its own.
+struct ANCHORTELEPORTATION_API FTeleportAnchorTable
+{
+	FAnchorLocationCache Locations;
+
+	TArray<int32> GroupStarts;
+
+	// Partner of every anchor, resolved and checked once per build so teleports only index into it. INDEX_NONE for orphans
+	TArray<int32> PairedIndex;
+
+	// Reverse of Locations.Anchors, pairing lookups and Admit redirects go through IndexOf
+	TMap<const AAnchor*, int32> AnchorIndices;
+
+	static TSharedRef<const FTeleportAnchorTable> Build(TConstArrayView<AAnchor*> InAnchors);
+
+	int32 NumAnchors() const { return Locations.Num(); }
+
+	int32 NumGroups() const { return FMath::Max(GroupStarts.Num() - 1, 0); }
+
+	int32 IndexOf(const AAnchor* Anchor) const
+	{
+		const int32* Index = AnchorIndices.Find(Anchor);
+		return Index ? *Index : INDEX_NONE;
+	}
+
+	int32 GroupSize(int32 Group) const { return GroupStarts[Group + 1] - GroupStarts[Group]; }
+
+	TConstArrayView<AAnchor*> GetGroup(int32 Group) const
+	{
+		return MakeArrayView(Locations.Anchors.GetData() + GroupStarts[Group], GroupSize(Group));
+	}
+
+	// First other anchor in the group of the anchor at AnchorIndex
+	AAnchor* FindPaired(int32 AnchorIndex) const
+	{
+		const int32 Paired = PairedIndex.IsValidIndex(AnchorIndex) ? PairedIndex[AnchorIndex] : INDEX_NONE;
+		return Paired != INDEX_NONE ? Locations.Anchors[Paired] : nullptr;
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Locations.GetAllocatedSize() + GroupStarts.GetAllocatedSize() + PairedIndex.GetAllocatedSize() + AnchorIndices.GetAllocatedSize();
+	}
+};
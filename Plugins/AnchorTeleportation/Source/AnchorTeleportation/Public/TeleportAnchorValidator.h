@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_EDITOR
+
+class AAnchor;
+
+// Editor-side index of every anchor in a world by AnchorID, unloaded World Partition actors included.
+// Anchors are tracked as they load or change and only groups touched since the last check are validated again.
+class ANCHORTELEPORTATION_API FTeleportAnchorValidator
+{
+public:
+	// Actor desc properties, so groups can be checked without loading World Partition cells
+	static const FName AnchorIDProperty;
+	static const FName RemoteProperty;
+
+	void Update(const AAnchor* Anchor);
+
+	void Remove(const AAnchor* Anchor);
+
+	// Full pass over the actor descs of the world's partition plus every loaded level
+	void Rebuild(UWorld* World);
+
+	bool IsBuilt() const { return bBuilt; }
+
+	// Problems with the group of Anchor, after re-checking any dirty groups
+	void GetGroupIssues(const AAnchor* Anchor, TArray<FText>& OutIssues);
+
+	// Every group with a problem, for teleport.validate.anchors and the cook
+	int32 Report(FOutputDevice& Ar, ELogVerbosity::Type Verbosity);
+
+	static int32 GetMaxGroupSize();
+
+	// Validates every map the cooker saves, errors fail the cook. Called from the module
+	static void RegisterCookValidation();
+	static void UnregisterCookValidation();
+
+private:
+	struct FAnchorRecord
+	{
+		FName AnchorID;
+		bool bRemote = false;
+	};
+
+	struct FGroup
+	{
+		TArray<FSoftObjectPath> Members;
+		TArray<FText> Issues;
+	};
+
+	void Track(const FSoftObjectPath& Path, FName AnchorID, bool bRemote);
+
+	void ValidateDirtyGroups();
+
+	TMap<FSoftObjectPath, FAnchorRecord> Anchors;
+	TMap<FName, FGroup> Groups;
+	TSet<FName> DirtyGroups;
+	bool bBuilt = false;
+};
+
+#endif
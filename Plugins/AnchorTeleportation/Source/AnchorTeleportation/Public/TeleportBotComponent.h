@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "TeleportBotComponent.generated.h"
+
+// Client side autopilot for load testing, drives the same calls a player's input would:
+// teleport requests, running into big pieces and collecting the small ones. Compiled out of shipping builds
+UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class ANCHORTELEPORTATION_API UTeleportBotComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UTeleportBotComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Relative weights as "teleport=1,break=1,pickup=2", missing entries keep their value
+	void SetBehaviorMix(const FString& Mix);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|Bot")
+	float TeleportWeight = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|Bot")
+	float BreakWeight = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|Bot")
+	float PickupWeight = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|Bot")
+	float DecisionInterval = 2.f; // Average seconds between picking a new action
+
+	// Client processes started with -TeleportBot=<mix> get a bot on their pawn
+	static bool GetCommandLineMix(FString& OutMix);
+
+private:
+	enum class EBotAction : uint8
+	{
+		Idle,
+		Teleport,
+		Break,
+		Pickup
+	};
+
+	void ChooseAction(APawn* Pawn);
+
+	bool FindPickupTarget(const FVector& From);
+
+	EBotAction Action = EBotAction::Idle;
+
+	double NextDecisionTime = 0.0;
+
+	TWeakObjectPtr<AActor> TargetActor;
+
+	FVector TargetLocation = FVector::ZeroVector;
+
+	FRandomStream Random;
+};
@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/DateTime.h"
+#include "TeleportStateStore.h"
+
+// What a gating policy gets to look at and spend. Charges are the component's replicated piece count
+struct FTeleportGateContext
+{
+	double Now = 0.0;
+	float Cooldown = 0.f;
+	uint32& Charges;
+};
+
+// Decides whether a player may teleport and what a teleport costs. One instance per component, picked once in BeginPlay
+class ANCHORTELEPORTATION_API ITeleportGatingPolicy
+{
+public:
+	virtual ~ITeleportGatingPolicy() = default;
+
+	virtual bool CanTeleport(const FTeleportGateContext& Context) const = 0;
+
+	// Spends the cost of a teleport that is about to happen, false when it can no longer be paid
+	virtual bool Commit(FTeleportGateContext& Context) = 0;
+
+	// Policy state that follows the player between servers, Now is the world time the state is relative to
+	virtual void SaveState(FTeleportPlayerState& State, double Now) const {}
+
+	virtual void RestoreState(const FTeleportPlayerState& State, double Now) {}
+
+	virtual SIZE_T GetInstanceSize() const = 0;
+};
+
+// Built-in policies share one implementation, the unused half of the state and checks compile away
+template<bool bSpendsCharges, bool bHasCooldown>
+struct TTeleportCooldownState
+{
+};
+
+template<bool bSpendsCharges>
+struct TTeleportCooldownState<bSpendsCharges, true>
+{
+	double LastTeleportTime = -MAX_dbl;
+};
+
+template<bool bSpendsCharges, bool bHasCooldown>
+class TTeleportGatingPolicy final : public ITeleportGatingPolicy, private TTeleportCooldownState<bSpendsCharges, bHasCooldown>
+{
+public:
+	virtual bool CanTeleport(const FTeleportGateContext& Context) const override
+	{
+		if constexpr (bSpendsCharges)
+		{
+			if (Context.Charges == 0) return false;
+		}
+		if constexpr (bHasCooldown)
+		{
+			if (Context.Now - this->LastTeleportTime < Context.Cooldown) return false;
+		}
+		return true;
+	}
+
+	virtual bool Commit(FTeleportGateContext& Context) override
+	{
+		if (!CanTeleport(Context)) return false;
+
+		if constexpr (bSpendsCharges)
+		{
+			Context.Charges--;
+		}
+		if constexpr (bHasCooldown)
+		{
+			this->LastTeleportTime = Context.Now;
+		}
+		return true;
+	}
+
+	virtual void SaveState(FTeleportPlayerState& State, double Now) const override
+	{
+		if constexpr (bHasCooldown)
+		{
+			if (this->LastTeleportTime > -MAX_dbl)
+			{
+				State.LastTeleportUtc = FDateTime::UtcNow().ToUnixTimestampDecimal() - (Now - this->LastTeleportTime);
+			}
+		}
+	}
+
+	virtual void RestoreState(const FTeleportPlayerState& State, double Now) override
+	{
+		if constexpr (bHasCooldown)
+		{
+			if (State.LastTeleportUtc > 0.0)
+			{
+				const double SecondsAgo = FDateTime::UtcNow().ToUnixTimestampDecimal() - State.LastTeleportUtc;
+				this->LastTeleportTime = FMath::Max(this->LastTeleportTime, Now - SecondsAgo);
+			}
+		}
+	}
+
+	virtual SIZE_T GetInstanceSize() const override { return sizeof(*this); }
+};
+
+using FTeleportCooldownPolicy = TTeleportGatingPolicy<false, true>;
+using FTeleportChargesPolicy = TTeleportGatingPolicy<true, false>;
+using FTeleportChargesAndCooldownPolicy = TTeleportGatingPolicy<true, true>;
+using FTeleportUnlimitedPolicy = TTeleportGatingPolicy<false, false>;
+
+// Name to factory map for gating policies, game modules can register their own at startup
+class ANCHORTELEPORTATION_API FTeleportGatingPolicyRegistry
+{
+public:
+	using FFactory = TFunction<TUniquePtr<ITeleportGatingPolicy>()>;
+
+	static void Register(FName PolicyName, FFactory Factory);
+
+	static void Unregister(FName PolicyName);
+
+	// Null when nothing is registered under the name
+	static TUniquePtr<ITeleportGatingPolicy> Create(FName PolicyName);
+
+	static const FName Cooldown;
+	static const FName Charges;
+	static const FName ChargesAndCooldown;
+	static const FName Unlimited;
+
+private:
+	static TMap<FName, FFactory>& GetFactories();
+};
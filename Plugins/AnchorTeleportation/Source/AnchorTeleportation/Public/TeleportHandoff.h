@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+// Client side bookkeeping for teleports that leave this server, survives the world swap
+class ANCHORTELEPORTATION_API FTeleportHandoff
+{
+public:
+	// Starts streaming the destination map so the travel only has to swap worlds, the package is kept until arrival
+	// or until the next UpdatePreloads no longer lists it
+	static void PreloadDestination(const FString& MapPackageName);
+
+	// Preloads every map in MapsInRange and releases the other preloads, a travel in progress keeps them all
+	static void UpdatePreloads(const TSet<FString>& MapsInRange);
+
+	static bool IsPreloaded(const FString& MapPackageName);
+
+	static void BeginTravel(const FString& URL);
+
+	// Called once the local pawn exists in the new world, logs the handoff time and releases the preloaded maps
+	static void NotifyArrived(UWorld* World);
+
+	// URL option carrying the destination anchor ID
+	static constexpr const TCHAR* AnchorOption = TEXT("TeleportAnchor");
+
+	// Seconds the destination server honors the arrival anchor the source server stored for a player
+	static constexpr double ArrivalTimeout = 120.0;
+};
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+enum class ETeleportHitchSection : uint8
+{
+	AnchorScan,
+	GhostSpawn,
+	GhostMaterial,
+	Move,
+	PieceSpawnTrace,
+	Num
+};
+
+const TCHAR* LexToString(ETeleportHitchSection Section);
+
+// World state written next to the section timings of a hitch
+struct FTeleportHitchWorldCounts
+{
+	int32 Anchors = 0;
+	int32 ActiveTeleports = 0;
+	int32 Ghosts = 0;
+	int32 FreeGhostMaterials = 0;
+	int32 Pieces = 0;
+};
+
+// Sums the time spent in the teleport sections between two frames and reports frames that go over budget.
+// Sections may be timed from any thread, the frame is closed from the game thread
+class ANCHORTELEPORTATION_API FTeleportHitchDetector
+{
+public:
+	static FTeleportHitchDetector& Get();
+
+	static bool IsEnabled();
+
+	void AddSectionTime(ETeleportHitchSection Section, uint64 Cycles)
+	{
+		SectionCycles[static_cast<int32>(Section)].fetch_add(Cycles, std::memory_order_relaxed);
+		SectionCalls[static_cast<int32>(Section)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Checks the sections timed since the last call against the budget, once per engine frame
+	void EndFrame(const UWorld* World, const FTeleportHitchWorldCounts& Counts);
+
+private:
+	void ReportHitch(const UWorld* World, const FTeleportHitchWorldCounts& Counts, const uint64 (&Cycles)[static_cast<int32>(ETeleportHitchSection::Num)],
+		const uint32 (&Calls)[static_cast<int32>(ETeleportHitchSection::Num)], double TotalMs);
+
+	std::atomic<uint64> SectionCycles[static_cast<int32>(ETeleportHitchSection::Num)] = {};
+	std::atomic<uint32> SectionCalls[static_cast<int32>(ETeleportHitchSection::Num)] = {};
+
+	uint64 LastFrame = 0;
+	double LastReportTime = -MAX_dbl;
+};
+
+// Adds the time spent in its scope to a section, costs two cycle reads while the detector is on and nothing otherwise
+class FTeleportHitchScope
+{
+public:
+	explicit FTeleportHitchScope(ETeleportHitchSection InSection)
+		: Section(InSection)
+		// Only game thread time adds to the frame, a section that also runs in a task is not counted there
+		, StartCycles(FTeleportHitchDetector::IsEnabled() && IsInGameThread() ? FPlatformTime::Cycles64() : 0)
+	{
+	}
+
+	~FTeleportHitchScope()
+	{
+		if (StartCycles != 0)
+		{
+			FTeleportHitchDetector::Get().AddSectionTime(Section, FPlatformTime::Cycles64() - StartCycles);
+		}
+	}
+
+private:
+	ETeleportHitchSection Section;
+	uint64 StartCycles;
+};
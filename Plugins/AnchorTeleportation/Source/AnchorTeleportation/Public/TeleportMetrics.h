@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+enum class ETeleportRejectReason : uint8
+{
+	RateLimited,
+	NoPawn,
+	AlreadyTeleporting,
+	Gated,        // Refused or unpaid by the gating policy
+	NoAnchor,     // No anchor near enough, or one without a partner
+	QueueTimeout, // Gave up waiting at a full anchor
+	Other,
+	Num
+};
+
+const TCHAR* LexToString(ETeleportRejectReason Reason);
+
+// Sums over the last few seconds in per-second buckets. Any thread may add, a bucket that is being recycled
+// can drop an add or two, which is fine for statistics
+class ANCHORTELEPORTATION_API FTeleportRollingCounter
+{
+public:
+	static constexpr int32 NumBuckets = 16;
+
+	void Add(uint64 Amount = 1)
+	{
+		const uint64 Second = static_cast<uint64>(FPlatformTime::Seconds());
+		FBucket& Bucket = Buckets[Second % NumBuckets];
+		uint64 BucketSecond = Bucket.Second.load(std::memory_order_relaxed);
+		if (BucketSecond != Second && Bucket.Second.compare_exchange_strong(BucketSecond, Second, std::memory_order_relaxed))
+		{
+			Bucket.Value.store(0, std::memory_order_relaxed);
+		}
+		Bucket.Value.fetch_add(Amount, std::memory_order_relaxed);
+		Total.fetch_add(Amount, std::memory_order_relaxed);
+	}
+
+	// Sum over the last Seconds complete seconds, the current one is still filling up
+	uint64 Sum(int32 Seconds) const;
+
+	uint64 GetTotal() const { return Total.load(std::memory_order_relaxed); }
+
+private:
+	struct FBucket
+	{
+		std::atomic<uint64> Second = 0;
+		std::atomic<uint64> Value = 0;
+	};
+
+	FBucket Buckets[NumBuckets];
+	std::atomic<uint64> Total = 0;
+};
+
+// Process-wide teleport counters printed by teleport.stats, cheap enough to stay on in shipping servers
+class ANCHORTELEPORTATION_API FTeleportMetrics
+{
+public:
+	static FTeleportMetrics& Get();
+
+	static constexpr int32 WindowSeconds = 10;
+
+	void CountReject(ETeleportRejectReason Reason) { Rejects[static_cast<int32>(Reason)].Add(); }
+
+	void Dump(FOutputDevice& Ar) const;
+
+	FTeleportRollingCounter Teleports;
+	FTeleportRollingCounter Rejects[static_cast<int32>(ETeleportRejectReason::Num)];
+	FTeleportRollingCounter AnchorLookups;
+	FTeleportRollingCounter AnchorLookupCycles;
+};
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Fixed ring of recent server-side positions, 256 bytes per player. The positions are the server's own, so this is
+// lag tolerance rather than a spoofing check: a request sent while standing at an anchor can be processed after the
+// server has already moved the player past it
+struct FTeleportMovementHistory
+{
+	static constexpr int32 Capacity = 16;
+
+	FVector3f Positions[Capacity];
+	float Times[Capacity];
+	int32 Head = 0;
+	int32 Count = 0;
+
+	void Add(const FVector& Location, float Time)
+	{
+		Positions[Head] = FVector3f(Location);
+		Times[Head] = Time;
+		Head = (Head + 1) % Capacity;
+		Count = FMath::Min(Count + 1, Capacity);
+	}
+
+	float LatestTime() const
+	{
+		return Count > 0 ? Times[(Head + Capacity - 1) % Capacity] : -MAX_flt;
+	}
+
+	// True if any sample from the last Window seconds lies within Radius of Point
+	bool WasNear(const FVector& Point, float Radius, float Now, float Window) const
+	{
+		const FVector3f Point3f(Point);
+		const float RadiusSquared = Radius * Radius;
+		const float OldestAllowed = Now - Window;
+
+		for (int32 i = 0; i < Count; i++)
+		{
+			if (Times[i] >= OldestAllowed && FVector3f::DistSquared(Positions[i], Point3f) <= RadiusSquared)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+};
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "TeleportStateStore.h"
+#include "TeleportPersistenceSubsystem.generated.h"
+
+// Read cache and write-behind queue in front of the teleport state store, lives across map changes of one server
+UCLASS(Config = Game)
+class ANCHORTELEPORTATION_API UTeleportPersistenceSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Swaps the backend, pending writes go to the old one first
+	void SetStore(TSharedRef<ITeleportStateStore> InStore);
+
+	// Answers from the cache when it can, OnLoaded always runs on the game thread
+	void Get(const FString& PlayerKey, TFunction<void(TOptional<FTeleportPlayerState>)> OnLoaded);
+
+	// Updates the cache right away, the store sees it with the next batch
+	void Put(const FString& PlayerKey, const FTeleportPlayerState& State);
+
+	// Hands the queued writes to the store without waiting, call before a player leaves for another server.
+	// The task completes once they are written
+	UE::Tasks::FTask FlushPendingWrites();
+
+	// Forgets the cached state once the player left, the next Get reads what other servers wrote since
+	void Evict(const FString& PlayerKey);
+
+	// Time a server travel waited for its handoff save, from FlushPendingWrites until the store finished
+	void RecordHandoffWait(double Seconds);
+
+	void DumpStats(FOutputDevice& Ar) const;
+
+	static FString GetPlayerKey(const class AController* Controller);
+
+private:
+	// Seconds between batches, read once when the ticker is added. Set under [/Script/AnchorTeleportation.TeleportPersistenceSubsystem]
+	UPROPERTY(Config)
+	float FlushInterval = 2.f;
+
+	bool TickFlush(float DeltaTime);
+
+	TSharedPtr<ITeleportStateStore> Store;
+
+	TMap<FString, FTeleportPlayerState> Cache;
+
+	TMap<FString, FTeleportPlayerState> PendingWrites;
+
+	FTSTicker::FDelegateHandle FlushTickerHandle;
+
+	int32 NumLoads = 0;
+	double TotalLoadSeconds = 0.0;
+	double MaxLoadSeconds = 0.0;
+	int32 NumWrites = 0;
+	int32 NumPuts = 0;
+	double TotalPutSeconds = 0.0;
+	double MaxPutSeconds = 0.0;
+	int32 NumHandoffs = 0;
+	double TotalHandoffSeconds = 0.0;
+	double MaxHandoffSeconds = 0.0;
+};
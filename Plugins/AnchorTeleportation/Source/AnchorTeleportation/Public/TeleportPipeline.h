@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+#include "TeleportAnchorTable.h"
+
+class AAnchor;
+class ACharacter;
+class APlayerController;
+
+enum class ETeleportStage : uint8
+{
+	Validate,
+	Resolve,            // Nearest anchor lookup, large tables are searched on a worker thread
+	Admit,              // Waits for room at a target anchor with an arrival capacity, or moves to a sibling with room
+	PreloadDestination, // Relevancy and streaming around the target
+	ReserveLanding,
+	FadeOut,
+	Move,
+	FadeIn,
+	Num
+};
+
+ANCHORTELEPORTATION_API const TCHAR* LexToString(ETeleportStage Stage);
+
+enum class ETeleportStageResult : uint8
+{
+	Pending, // Run the stage again next frame
+	Complete,
+	Failed
+};
+
+// Server side state of one teleport in flight, advanced a stage at a time by the world subsystem
+struct FTeleportPipeline
+{
+	ETeleportStage Stage = ETeleportStage::Validate;
+	bool bStageEntered = false;
+	double StartTime = 0.0;
+	double StageStartTime = 0.0;      // Platform time, for latency metrics
+	double StageStartWorldTime = 0.0; // World time, for waits
+
+	TWeakObjectPtr<APlayerController> PlayerController;
+	TWeakObjectPtr<ACharacter> Character;
+
+	FVector SourceLocation = FVector::ZeroVector;
+	TSharedPtr<const FTeleportAnchorTable> AnchorTable; // What ResolveTask searched, its anchor pointers are only safe while it is the current table
+	UE::Tasks::TTask<int32> ResolveTask;
+	TWeakObjectPtr<AAnchor> SourceAnchor;
+	TWeakObjectPtr<AAnchor> TargetAnchor;
+	FString TravelURL; // Set instead of TargetAnchor when the source anchor leads to another server
+	UE::Tasks::FTask HandoffSave; // The state store write the client waits on before it travels
+	double HandoffSaveStart = 0.0;
+
+	TWeakObjectPtr<AAnchor> QueuedAnchor; // Set while waiting in the arrival queue of the target
+	bool bArrivalAdmitted = false;
+
+	bool bDestinationRelevancySent = false; // The replication graph is sending the destination ahead of the move
+
+	FVector LandingLocation = FVector::ZeroVector;
+	int32 LandingSlot = INDEX_NONE;
+};
+
+// Wall time spent in a stage, which can span several frames
+struct FTeleportStageMetrics
+{
+	int32 Count = 0;
+	double TotalSeconds = 0.0;
+	double MaxSeconds = 0.0;
+
+	void Add(double Seconds)
+	{
+		Count++;
+		TotalSeconds += Seconds;
+		MaxSeconds = FMath::Max(MaxSeconds, Seconds);
+	}
+};
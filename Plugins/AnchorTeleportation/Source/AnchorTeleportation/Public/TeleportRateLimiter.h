@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Token bucket used to drop excess server RPCs before any expensive work is done
+struct FTeleportTokenBucket
+{
+	float Tokens = -1.f;
+	double LastRefillTime = 0.0;
+
+	bool TryConsume(double Now, float RatePerSecond, float Burst)
+	{
+		if (Tokens < 0.f)
+		{
+			// First call, start with a full bucket
+			Tokens = Burst;
+			LastRefillTime = Now;
+		}
+
+		Tokens = FMath::Min(Burst, Tokens + static_cast<float>(Now - LastRefillTime) * RatePerSecond);
+		LastRefillTime = Now;
+
+		if (Tokens < 1.f)
+		{
+			return false;
+		}
+
+		Tokens -= 1.f;
+		return true;
+	}
+};
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Pipe.h"
+
+// Teleport bookkeeping that follows a player between server instances
+struct FTeleportPlayerState
+{
+	uint32 Charges = 0;
+	double LastTeleportUtc = 0.0; // Unix seconds, 0 when the player never teleported
+
+	// Written by the server a player leaves through a remote anchor, consumed by the one they arrive on
+	FName PendingArrivalAnchor;
+	double PendingArrivalUtc = 0.0;
+};
+
+// Backend for teleport state. Calls come from the game thread and must not block on I/O, completions run on the game thread.
+class ANCHORTELEPORTATION_API ITeleportStateStore
+{
+public:
+	virtual ~ITeleportStateStore() = default;
+
+	virtual void Load(const FString& PlayerKey, TFunction<void(TOptional<FTeleportPlayerState>)> OnLoaded) = 0;
+
+	// The returned task completes once the states are written
+	virtual UE::Tasks::FTask SaveBatch(TArray<TPair<FString, FTeleportPlayerState>> States) = 0;
+
+	// Blocks until every queued save has been written, for shutdown
+	virtual void WaitForPendingSaves() = 0;
+};
+
+// Offline stand-in for a shared database: one small file per player under Saved/TeleportState, written on a background pipe
+class ANCHORTELEPORTATION_API FTeleportFileStateStore : public ITeleportStateStore
+{
+public:
+	explicit FTeleportFileStateStore(const FString& InDirectory);
+
+	virtual void Load(const FString& PlayerKey, TFunction<void(TOptional<FTeleportPlayerState>)> OnLoaded) override;
+
+	virtual UE::Tasks::FTask SaveBatch(TArray<TPair<FString, FTeleportPlayerState>> States) override;
+
+	virtual void WaitForPendingSaves() override;
+
+private:
+	FString GetFilename(const FString& PlayerKey) const;
+
+	FString Directory;
+
+	// Loads and saves run in order, so a load never overtakes an earlier save of the same player
+	UE::Tasks::FPipe Pipe{ TEXT("TeleportFileStateStore") };
+
+	UE::Tasks::FTask LastSave;
+};
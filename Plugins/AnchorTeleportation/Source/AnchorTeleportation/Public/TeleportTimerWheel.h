@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FTeleportTimerHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Serial = 0;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+	void Invalidate() { Index = INDEX_NONE; }
+};
+
+// Hashed timing wheel for piece lifetimes: O(1) schedule and cancel, one Advance per frame
+class ANCHORTELEPORTATION_API FTeleportTimerWheel
+{
+public:
+	explicit FTeleportTimerWheel(double InTickSeconds = 0.05, int32 InNumSlots = 512);
+
+	FTeleportTimerHandle Schedule(double Delay, FSimpleDelegate Callback);
+
+	void Cancel(FTeleportTimerHandle& Handle);
+
+	// Returns how many entries fired
+	int32 Advance(double DeltaSeconds);
+
+	int32 Num() const { return Entries.Num(); }
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FEntry
+	{
+		FSimpleDelegate Callback;
+		uint32 Serial = 0;
+		int32 Rounds = 0; // Full turns of the wheel left before the entry is due
+	};
+
+	struct FSlotEntry
+	{
+		int32 Index;
+		uint32 Serial;
+	};
+
+	double TickSeconds;
+	double Accumulator = 0.0;
+	int64 CurrentTick = 0;
+	uint32 NextSerial = 1;
+
+	TSparseArray<FEntry> Entries;
+	TArray<TArray<FSlotEntry>> Slots;
+
+	// Reused between advances so firing a batch does not allocate
+	TArray<FSimpleDelegate> DueCallbacks;
+};
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class ETeleportTraceEvent : uint8
+{
+	AnchorName, // Defines the index used by later records for an anchor ID
+	Teleport,
+	Break,
+	Pickup
+};
+
+struct FTeleportTraceRecord
+{
+	ETeleportTraceEvent Type = ETeleportTraceEvent::Teleport;
+	float Time = 0.f; // Seconds since recording started
+	uint32 PlayerId = 0;
+	FVector3f Position = FVector3f::ZeroVector;
+	FName SourceAnchor;
+	FName TargetAnchor;
+};
+
+// Server-side binary log of teleport traffic, written in buffered chunks from the game thread
+class ANCHORTELEPORTATION_API FTeleportTraceRecorder
+{
+public:
+	static FTeleportTraceRecorder& Get();
+
+	bool Start(const FString& Filename);
+
+	void Stop();
+
+	bool IsRecording() const { return Writer.IsValid(); }
+
+	void RecordTeleport(uint32 PlayerId, const FVector& Position, FName SourceAnchor, FName TargetAnchor);
+
+	void RecordBreak(uint32 PlayerId, const FVector& Position);
+
+	void RecordPickup(uint32 PlayerId, const FVector& Position);
+
+	static uint32 GetPlayerId(const class AController* Controller);
+
+	static bool ReadTrace(const FString& Filename, TArray<FTeleportTraceRecord>& OutRecords);
+
+	static constexpr uint32 Magic = 0x54505254; // "TRPT"
+	static constexpr uint32 Version = 1;
+
+private:
+	void WriteRecordHeader(ETeleportTraceEvent Type, uint32 PlayerId, const FVector& Position);
+
+	int32 GetAnchorIndex(FName AnchorID);
+
+	// Records go to an in-memory chunk, the file is only touched once it fills up or on Stop
+	void FlushIfFull();
+
+	void Flush();
+
+	TUniquePtr<FArchive> Writer;
+	TArray<uint8> Buffer;
+	TMap<FName, int32> AnchorIndices;
+	double StartTime = 0.0;
+};
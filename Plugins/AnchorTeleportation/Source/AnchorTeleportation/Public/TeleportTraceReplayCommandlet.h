@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TeleportTraceReplayCommandlet.generated.h"
+
+// Replays the teleports, breaks and pickups of a recorded trace against a map and reports throughput and latency.
+// Usage: -run=TeleportTraceReplay -Trace=<file> -Map=</Game/Maps/Level> [-Repeat=N]
+UCLASS()
+class ANCHORTELEPORTATION_API UTeleportTraceReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTeleportTraceReplayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
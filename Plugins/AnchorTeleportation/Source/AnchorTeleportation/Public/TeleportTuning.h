@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Console overrides for designer-set values so a live server can be retuned without a restart.
+// The teleport.tune.* variables are negative by default, which keeps the value from the asset
+struct ANCHORTELEPORTATION_API FTeleportTuning
+{
+	static float GetCooldown(float AssetValue);
+
+	// Ghost fades run on clients, set it there to see it
+	static float GetFadeDuration(float AssetValue);
+
+	static int32 GetMaxPieces(int32 AssetValue);
+
+	static float GetRespawnTime(float AssetValue);
+
+	static float GetDespawnTime(float AssetValue);
+};
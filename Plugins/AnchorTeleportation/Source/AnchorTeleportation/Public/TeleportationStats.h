@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("AnchorTeleportation"), STATGROUP_AnchorTeleportation, STATCAT_Advanced);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Rejected Server RPCs"), STAT_TeleportRejectedRpcs, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Anchor Lookup"), STAT_TeleportAnchorLookup, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn After Image"), STAT_TeleportSpawnAfterImage, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Managed Pieces"), STAT_TeleportManagedPieces, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Piece Manager Tick"), STAT_TeleportPieceManagerTick, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Timer Wheel Fired"), STAT_TeleportTimerWheelFired, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Timer Wheel Entries"), STAT_TeleportTimerWheelEntries, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Teleport Pipeline Tick"), STAT_TeleportPipelineTick, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Teleports In Flight"), STAT_TeleportActivePipelines, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Teleport State Put"), STAT_TeleportStatePut, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Teleport Gating"), STAT_TeleportGating, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Teleport Move"), STAT_TeleportMove, STATGROUP_AnchorTeleportation, ANCHORTELEPORTATION_API);
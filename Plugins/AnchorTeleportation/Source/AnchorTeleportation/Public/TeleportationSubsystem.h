@@ -5,20 +5,80 @@
 #include "CoreMinimal.h"
 #include "Anchor.h"
 #include "Components/ActorComponent.h"
+#include "Net/Serialization/FastArraySerializer.h"
 #include "Pieces/SmallTeleportationPieces.h"
+#include "TeleportGatingPolicy.h"
+#include "TeleportMovementHistory.h"
+#include "TeleportPipeline.h"
+#include "TeleportRateLimiter.h"
+#include "TeleportationWorldSubsystem.h"
 #include "TeleportationSubsystem.generated.h"
 
 
 USTRUCT(BlueprintType)
-struct FReplicatedAnchorList
+struct FReplicatedAnchorList : public FFastArraySerializerItem
 {
 	GENERATED_BODY()
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
 	FName AnchorID;
 	
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	// Filled on clients only. The server keeps no copy per character and sends the group straight from the shared table,
+	// read it through GetAnchors() or UTeleportationSubsystem::GetAnchorGroup
+	UPROPERTY()
 	TArray<AAnchor*> Anchors;
+
+	// Server side, kept alive by the owning FReplicatedAnchorArray
+	const FTeleportAnchorTable* Table = nullptr;
+	int32 Group = INDEX_NONE;
+
+	TConstArrayView<AAnchor*> GetAnchors() const { return Table ? Table->GetGroup(Group) : TConstArrayView<AAnchor*>(Anchors); }
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FReplicatedAnchorList> : public TStructOpsTypeTraitsBase2<FReplicatedAnchorList>
+{
+	enum { WithNetSerializer = true };
+};
+
+// Anchor groups the owning client knows about, groups come and go individually as the player moves
+USTRUCT()
+struct FReplicatedAnchorArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FReplicatedAnchorList> Items;
+
+	// Server side, the table the items point into
+	TSharedPtr<const FTeleportAnchorTable> Table;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FReplicatedAnchorList, FReplicatedAnchorArray>(Items, DeltaParms, *this);
+	}
+};
+
+// Place of the owning player in the arrival queue of a full anchor
+USTRUCT(BlueprintType)
+struct FTeleportQueueStatus
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Teleportation")
+	int32 Position = 0; // 0 when not queued
+
+	// Estimate at the time it was sent, clients count it down locally
+	UPROPERTY(BlueprintReadOnly, Category = "Teleportation")
+	float EtaSeconds = 0.f;
+};
+
+template<>
+struct TStructOpsTypeTraits<FReplicatedAnchorArray> : public TStructOpsTypeTraitsBase2<FReplicatedAnchorArray>
+{
+	enum { WithNetDeltaSerializer = true };
 };
 
 UCLASS(Blueprintable, ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
@@ -31,55 +91,251 @@ protected:
 
 private:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
 	UTeleportationSubsystem();
 	
-	UFUNCTION(Server, Reliable, BlueprintCallable)
+	UFUNCTION(Server, Reliable, WithValidation, BlueprintCallable)
 	void ServerTeleportPlayer(APlayerController* PlayerController);
 
 	UFUNCTION(BlueprintCallable)
 	void ClientRequestTeleport(APlayerController* PlayerController);
+
+	// Server side, the teleport in flight for this component
+	TUniquePtr<FTeleportPipeline> ActiveTeleport;
+
+	// Advances the active teleport as far as it can go this frame, false once it is finished or cancelled
+	bool TickTeleport();
+
+	void CancelTeleport(const TCHAR* Reason);
+
+	void FinishTeleport();
+
+	ETeleportStageResult RunTeleportStage(FTeleportPipeline& Pipeline, bool bEntering, APlayerController* PlayerController, ACharacter* Character);
+
+	bool IsDestinationStreamedIn(const FVector& Location) const;
+
+	// Moves Actor and everything attached in one deferred transform update with teleport physics, overlaps are only
+	// gathered at the destination and character movement is told it teleported
+	static void TeleportMove(AActor* Actor, const FVector& Location);
+
+	UFUNCTION(Client, Unreliable)
+	void ClientTeleportFade(float FromAlpha, float ToAlpha, float Duration);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float TeleportFadeOutTime = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float TeleportFadeInTime = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float DestinationPreloadTimeout = 1.f; // Longest wait for World Partition to stream in the destination
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float DestinationRelevancyLeadTime = 0.15f; // With the teleport replication graph, how long destination actors replicate before the move
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float LandingSettleTime = 0.5f; // How long the landing spot stays reserved after the move, the capsule has to clear it first
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	int32 AsyncResolveMinAnchors = 4096; // Smaller tables are searched inline, a task would only add a frame
+
+	// Called by the world subsystem once the queued teleport may land
+	void OnArrivalAdmitted();
+
+	// Server side, only dirties ArrivalQueueStatus when the client's countdown would be off by more than a second
+	void UpdateArrivalQueueStatus(int32 Position, float EtaSeconds);
+
+	UFUNCTION(BlueprintCallable, Category = "Teleportation")
+	float GetArrivalQueueEta() const;
+
+	UFUNCTION()
+	void OnRep_ArrivalQueueStatus();
+
+	UPROPERTY(ReplicatedUsing = OnRep_ArrivalQueueStatus, BlueprintReadOnly, Category = "Teleportation")
+	FTeleportQueueStatus ArrivalQueueStatus;
+
+	double ArrivalQueueStatusTime = 0.0; // World time the current status was sent or received
 	
 	AAnchor* FindPairedAnchor(AAnchor* CurrentAnchor) const;
+
+	// Anchors of a replicated group, the same on the server, the listen host and clients. Empty when the group is not replicated
+	UFUNCTION(BlueprintPure, Category = "Teleportation")
+	TArray<AAnchor*> GetAnchorGroup(FName AnchorID) const;
+
+	// Server side, brings AnchorPairs in line with the groups near the owner. A changed table also updates groups out of range
+	void RefreshReplicatedAnchors(bool bAnchorTableChanged);
+
+	void OnAnchorTableChanged();
+
+	FTimerHandle AnchorInterestTimer;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float AnchorInterestRadius = 0.f; // Groups with an anchor this close to the owner are replicated, 0 replicates every group
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float AnchorInterestRefreshInterval = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	bool bRememberDiscoveredAnchors = true; // Groups stay replicated after the owner moves away from them
+
+	FDelegateHandle AnchorTableChangedHandle;
+
+	SIZE_T GetAllocatedSize() const;
+
+	// AnchorPairs items and any group copies they hold, which is only the case on clients
+	SIZE_T GetAnchorListAllocatedSize() const;
 	
 	bool CanTeleport(APlayerController* PlayerController) const;
-	
-	TMap<APlayerController*, float> LastTeleportTimes;
+
+	// Created in BeginPlay from TeleportPolicy, holds the cooldown of the owning controller when the policy has one
+	TUniquePtr<ITeleportGatingPolicy> GatingPolicy;
+
+	FName GetGatingPolicyName() const;
+
+	// Server side, pulls charges and cooldown the player had on this or another server
+	void RestorePersistentState();
+
+	// Queues the current charges and cooldown for the state store, a no-op until the restore finished
+	void SavePersistentState();
+
+	UFUNCTION()
+	void OnOwnerControllerChanged(APawn* Pawn, AController* OldController, AController* NewController);
+
+	FString PersistentPlayerKey; // Set once the restore finished
+
+	// Server side, moves a player who came through a remote anchor onto the arrival the source server stored for them.
+	// The anchor in their travel URL is only checked against it, clients cannot pick where they land
+	void PlaceAtArrivalAnchor(const FTeleportPlayerState& State);
+
+	// Set when the player leaves through a remote anchor, saved with the charges for the destination server
+	FName DepartureAnchorID;
+	double DepartureUtc = 0.0;
+
+	// Client side, streams in the maps behind remote anchors the local player is close to
+	void UpdateRemoteAnchorPreloads();
+
+	FTimerHandle RemoteAnchorPreloadTimer;
+
+	TArray<TWeakObjectPtr<AAnchor>> RemoteAnchors;
+
+	int32 RemoteAnchorRefreshCountdown = 0;
+
+	bool bArrivalNotified = false;
+
+	UFUNCTION(Client, Reliable)
+	void ClientTravelToAnchor(const FString& URL);
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
 	bool bPickUpTeleportation = false;
+
+	// Name registered with FTeleportGatingPolicyRegistry, None picks Charges or Cooldown from bPickUpTeleportation
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	FName TeleportPolicy;
 	
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
 	float TeleportCooldown = 5.0f;
 	
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
-	USoundCue* TeleportSoundCue;
+	TSoftObjectPtr<USoundCue> TeleportSoundCue;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
-	UMaterialInterface* GhostMaterial;
+	TSoftObjectPtr<UMaterialInterface> GhostMaterial;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
 	float FadeDuration = 6.f;
 	
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|AfterImage")
+	TSoftObjectPtr<class UStaticMesh> GhostImpostorMesh; // Mid-range stand-in, the skeletal copy without custom depth is used when unset
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|AfterImage")
+	float AfterImageFullDetailDistance = 2000.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|AfterImage")
+	float AfterImageCullDistance = 6000.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|AfterImage")
+	int32 MaxConcurrentGhosts = 32; // Per client, across every character in the world
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|AfterImage")
+	int32 MaxFullDetailGhosts = 8;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation|AfterImage")
+	int32 GhostMaterialPoolSize = 4;
+
+	// Effect assets stream in after BeginPlay, teleports before that happen without sound or ghost
+	void LoadEffectAssets();
+
+	TSharedPtr<struct FStreamableHandle> EffectAssetsHandle;
+
+	// Loads and primes the teleport effects so the first teleport costs the same as later ones
+	void PrewarmEffects();
+
+	EAfterImageLOD SelectAfterImageLOD(const FVector& Location) const;
+
+	void StartAfterImageFade(AActor* Ghost, UMaterialInstanceDynamic* DynamicMaterial);
+	
 	UPROPERTY(Replicated)
 	uint32 PickedUpPieces = 0;
 	
-	UFUNCTION(Server, Reliable)
+	UFUNCTION(Server, Reliable, WithValidation)
 	void ServerCollectTeleportationPiece(APlayerController* PlayerController);
 
 	UFUNCTION(BlueprintCallable, Category = "Teleportation")
 	void CollectTeleportationPiece(APlayerController* PlayerController);
 
+	// Server RPCs on this component only arrive from the owning connection, so one bucket is a per-connection limit
+	bool ConsumeServerRpcBudget();
+
+	bool IsRpcFromOwningConnection(APlayerController* PlayerController) const;
+
+	FTeleportTokenBucket ServerRpcBudget;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float ServerRpcRate = 10.f; // Sustained server RPCs per second
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float ServerRpcBurst = 20.f;
+
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Teleportation")
+	int32 RejectedRpcCount = 0;
+
+	// The player must stand this close to the source anchor, 0 keeps teleporting from the closest anchor at any distance
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float MaxTeleportSourceDistance = 0.f;
+
+	// Samples this recent also count, so a player who walked or was knocked off the anchor while the request
+	// was in flight is not refused. Should cover the worst round trip you expect
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float TeleportSourceWindow = 0.5f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
+	float MovementSampleInterval = 0.05f;
+
+	// Server side, sampled from the owner's movement updates
+	FTeleportMovementHistory MovementHistory;
+
+	UFUNCTION()
+	void OnOwnerMovementUpdated(float DeltaSeconds, FVector OldLocation, FVector OldVelocity);
+
+	bool WasRecentlyNear(const AAnchor* SourceAnchor) const;
+
 	// UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Teleportation")
 	// UNiagaraSystem* TeleportNiagaraEffect;
 	
 	UPROPERTY(Replicated)
-	TArray<FReplicatedAnchorList> AnchorPairs;
+	FReplicatedAnchorArray AnchorPairs;
 
 	UPROPERTY()
 	ASmallTeleportationPieces* Pieces;
 
 	UFUNCTION(NetMulticast, Reliable)
 	void SpawnAfterImage(FVector Location, ACharacter* OriginalCharacter);
+
+	// Spawned ghosts carry this tag, their copy of the component skips all setup
+	static const FName AfterImageTag;
+
+	UPROPERTY(Transient)
+	bool bIsAfterImage = false;
 };
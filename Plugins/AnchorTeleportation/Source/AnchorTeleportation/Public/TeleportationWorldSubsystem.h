@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TeleportAnchorRegistry.h"
+#include "TeleportAnchorValidator.h"
+#include "TeleportPipeline.h"
+#include "TeleportTimerWheel.h"
+#include "UObject/ObjectKey.h"
+#include "TeleportationWorldSubsystem.generated.h"
+
+class AAnchor;
+class ATeleportationPieceManager;
+class USkeletalMesh;
+class USoundCue;
+class UStaticMesh;
+class UTeleportationSubsystem;
+
+UENUM(BlueprintType)
+enum class EAfterImageLOD : uint8
+{
+	Full,     // Skeletal mesh copy with custom depth
+	Impostor, // Static mesh stand-in
+	Culled    // Not spawned at all
+};
+
+enum class ETeleportServerRpc : uint8
+{
+	Teleport,
+	CollectPiece,
+	BreakSource,
+	Num
+};
+
+// World-wide state shared by every UTeleportationSubsystem in the world
+UCLASS()
+class ANCHORTELEPORTATION_API UTeleportationWorldSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterAnchor(AAnchor* Anchor);
+
+	void UnregisterAnchor(AAnchor* Anchor);
+
+	// Game thread, publishes a rebuilt snapshot first if anchors changed since the last one
+	TSharedRef<const FTeleportAnchorTable> GetAnchorTable();
+
+	// For async readers, hold on to the registry and call Read() from any thread
+	TSharedRef<FTeleportAnchorRegistry> GetAnchorRegistry() const { return AnchorRegistry; }
+
+	// Fired from Tick once per batch of anchor changes
+	FSimpleMulticastDelegate OnAnchorTableChanged;
+
+	// Bytes held by the teleport structures of this world, printed by teleport.memreport
+	void DumpMemoryReport(FOutputDevice& Ar);
+
+	// Runs the first stages right away and keeps ticking the component's pipeline until it finishes
+	void StartTeleport(UTeleportationSubsystem* Component);
+
+	void RecordStageLatency(ETeleportStage Stage, double Seconds);
+
+	// Request to completion of a successful teleport, for the load report percentiles
+	void RecordTeleportLatency(double Seconds);
+
+	void CountServerRpc(ETeleportServerRpc Rpc);
+
+	// Server frame time, RPC rates, bandwidth per connection and teleport latency since the last reset
+	void DumpLoadReport(FOutputDevice& Ar) const;
+
+	void ResetLoadReport();
+
+	void DumpPipelineStats(FOutputDevice& Ar) const;
+
+	// Rolling counters from FTeleportMetrics plus the live piece, ghost and pool counts of this world, printed by teleport.stats
+	void DumpStats(FOutputDevice& Ar) const;
+
+	// Picks a free spot around Location at least Spacing away from other teleports still landing
+	FVector ReserveLandingSlot(const FVector& Location, float Spacing, int32& OutSlot);
+
+	// With a SettleTime the spot stays taken that much longer, so the next arrival does not land on a player who just got there
+	void ReleaseLandingSlot(int32& Slot, float SettleTime = 0.f);
+
+	// Arrival admission for anchors with an ArrivalCapacity. True when Component may land now, otherwise it is queued
+	// and gets OnArrivalAdmitted from Tick once its turn comes
+	bool RequestArrival(AAnchor* Anchor, UTeleportationSubsystem* Component);
+
+	// True when a request at Anchor would be admitted right away
+	bool HasArrivalRoom(const AAnchor* Anchor);
+
+	void LeaveArrivalQueue(AAnchor* Anchor, UTeleportationSubsystem* Component);
+
+	void CountRedirectedArrival() { NumRedirectedArrivals++; }
+
+	// Piece despawn, pickup enable and source respawn all run off this instead of the world timer manager
+	FTeleportTimerWheel TimerWheel;
+
+	void RegisterGhost(AActor* Ghost, EAfterImageLOD LOD);
+
+	int32 NumGhosts() const;
+
+	int32 NumGhosts(EAfterImageLOD LOD) const;
+
+	// Primes the sound, shaders and PSOs of the teleport effects, each asset once per world however many
+	// characters share it
+	void PrewarmEffects(USoundCue* SoundCue, UMaterialInterface* GhostMaterial, int32 GhostMaterialPoolSize,
+		USkeletalMesh* SkeletalMesh, UStaticMesh* ImpostorMesh);
+
+	// Tops the free pool for Parent up to Count instances
+	void PrewarmGhostMaterials(UMaterialInterface* Parent, int32 Count);
+
+	UMaterialInstanceDynamic* AcquireGhostMaterial(UMaterialInterface* Parent);
+
+	void ReleaseGhostMaterial(UMaterialInstanceDynamic* Material);
+
+	// Server only, uses a manager placed in the level or spawns one of ManagerClass
+	ATeleportationPieceManager* GetOrSpawnPieceManager(TSubclassOf<ATeleportationPieceManager> ManagerClass);
+
+#if WITH_EDITOR
+	FTeleportAnchorValidator& GetAnchorValidator() { return AnchorValidator; }
+#endif
+
+private:
+	UPROPERTY()
+	TObjectPtr<ATeleportationPieceManager> PieceManager;
+
+	UPROPERTY()
+	TArray<TObjectPtr<AAnchor>> RegisteredAnchors;
+
+	// Position of every anchor in RegisteredAnchors, streaming in thousands of anchors must not scan the array each time
+	TMap<TObjectKey<AAnchor>, int32> RegisteredAnchorIndices;
+
+	TSharedRef<FTeleportAnchorRegistry> AnchorRegistry = MakeShared<FTeleportAnchorRegistry>();
+
+#if WITH_EDITOR
+	FTeleportAnchorValidator AnchorValidator;
+#endif
+
+	bool bAnchorTableDirty = false;
+
+	bool bAnchorTableChanged = false;
+
+	UPROPERTY()
+	TArray<TObjectPtr<UMaterialInstanceDynamic>> FreeGhostMaterials;
+
+	// Held here while a ghost uses them so they survive until released
+	UPROPERTY()
+	TArray<TObjectPtr<UMaterialInstanceDynamic>> InUseGhostMaterials;
+
+	TArray<TWeakObjectPtr<UTeleportationSubsystem>> ActiveTeleports;
+
+	FTeleportStageMetrics StageMetrics[static_cast<int32>(ETeleportStage::Num)];
+
+	TSparseArray<FVector> ReservedLandings;
+
+	void FreeLandingSlot(int32 Slot);
+
+	// Token bucket per anchor that refills ArrivalCapacity arrivals per ArrivalWindow, plus the players waiting on it
+	struct FAnchorAdmission
+	{
+		float Tokens = 0.f;
+		double LastRefillTime = 0.0;
+		TArray<TWeakObjectPtr<UTeleportationSubsystem>> Queue;
+	};
+
+	TMap<TObjectKey<AAnchor>, FAnchorAdmission> Admissions;
+
+	void RefillArrivals(FAnchorAdmission& Admission, const AAnchor& Anchor) const;
+
+	void TickArrivalQueues();
+
+	double LoadReportStartTime = 0.0;
+	int32 ServerRpcCounts[static_cast<int32>(ETeleportServerRpc::Num)] = {};
+	TArray<float> FrameTimes; // Game thread work per frame, idle wait excluded
+	TArray<float> TeleportLatencies;
+	int32 NumQueuedArrivals = 0;
+	int32 NumRedirectedArrivals = 0;
+	int32 MaxArrivalQueue = 0;
+
+	// Set on bot clients, see UTeleportBotComponent
+	FString BotMix;
+	bool bBotMixParsed = false;
+
+	void UpdateBot();
+
+	struct FActiveGhost
+	{
+		TWeakObjectPtr<AActor> Ghost;
+		EAfterImageLOD LOD;
+	};
+
+	void PruneGhosts() const;
+
+	mutable TArray<FActiveGhost> ActiveGhosts;
+
+	// Assets and mesh and material pairs PrewarmEffects already handled
+	TSet<TPair<FObjectKey, FObjectKey>> PrewarmedEffects;
+
+	// True the first time the pair is seen
+	bool MarkPrewarmed(const UObject* Asset, const UObject* Material = nullptr);
+};